@@ -0,0 +1,131 @@
+// shared by the shadowing compute shaders, mirrored in src/light_space.cpp
+
+#define LIGHT_NEAR -10.0
+#define LIGHT_FAR 1000.0
+
+struct Particle {
+  vec3 pos;
+  float _pad0;
+  float radius;
+  float opacity;
+  vec2 _pad1;
+};
+
+mat4 ortho(float left, float right, float bottom, float top, float zNear, float zFar) {
+    mat4 result = mat4(1.0);
+    result[0][0] = 2.0 / (right - left);
+    result[1][1] = 2.0 / (top - bottom);
+    result[2][2] = 1.0 / (zFar - zNear);
+    result[3][0] = - (right + left) / (right - left);
+    result[3][1] = - (top + bottom) / (top - bottom);
+    result[3][2] = - zNear / (zFar - zNear);
+
+    return result;
+}
+
+mat4 lookAt(vec3 eye, vec3 center, vec3 up) {
+    vec3 f = normalize(center - eye);
+    vec3 s = normalize(cross(f, up));
+    vec3 u = cross(s, f);
+
+    mat4 result = mat4(1.0);
+    result[0][0] = s.x;
+    result[1][0] = s.y;
+    result[2][0] = s.z;
+    result[0][1] = u.x;
+    result[1][1] = u.y;
+    result[2][1] = u.z;
+    result[0][2] = f.x;
+    result[1][2] = f.y;
+    result[2][2] = f.z;
+    result[3][0] = -dot(s, eye);
+    result[3][1] = -dot(u, eye);
+    result[3][2] = -dot(f, eye);
+
+    return result;
+}
+
+mat4 lightMatrix(vec3 sunDir) {
+    sunDir = normalize(sunDir);
+
+    mat4 lightProjection = ortho(-1.0, 1.0, -1.0, 1.0, LIGHT_NEAR, LIGHT_FAR);
+    mat4 lightView = lookAt(-sunDir, vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0));
+
+    return lightProjection * lightView;
+}
+
+// vector.w == 0: a directional light shining along vector.xyz like sunDir,
+// vector.w == 1: a point light at vector.xyz
+struct Light {
+  vec4 vector;
+  float intensity;
+  float _pad0;
+  vec2 _pad1;
+};
+
+// radius of discs behind a point light, never overlaps anything
+#define LIGHT_BEHIND_RADIUS -3.0e38
+
+// lightMatrix for directional lights, a view looking at the origin for point
+// lights
+mat4 lightTransform(Light light) {
+    if (light.vector.w == 0.0) {
+        return lightMatrix(light.vector.xyz);
+    }
+
+    return lookAt(light.vector.xyz, vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0));
+}
+
+// xy and radius of a particle's disc as seen from the light, transform comes
+// from lightTransform. Point lights divide by the distance along their view
+// axis, which keeps the overlap fractions of circleOverlap
+vec3 lightProjectDisc(Light light, mat4 transform, vec3 position, float radius) {
+    vec3 transformed = (transform * vec4(position, 1.0)).xyz;
+    if (light.vector.w == 0.0) {
+        return vec3(transformed.xy, radius);
+    }
+
+    if (transformed.z <= 0.0) {
+        return vec3(0.0, 0.0, LIGHT_BEHIND_RADIUS);
+    }
+
+    return vec3(transformed.xy, radius) / transformed.z;
+}
+
+// maps a float to a uint with the same ordering, used as a radix sort key
+uint depthKey(float depth) {
+    uint bits = floatBitsToUint(depth);
+    return (bits & 0x80000000u) != 0u ? ~bits : bits | 0x80000000u;
+}
+
+// inverse of depthKey
+float depthFromKey(uint key) {
+    uint bits = (key & 0x80000000u) != 0u ? key & 0x7fffffffu : ~key;
+    return uintBitsToFloat(bits);
+}
+
+float circleOverlap(vec2 sphere1_center, float sphere1_radius, vec2 sphere2_center, float sphere2_radius) {
+    float distance = distance(sphere1_center, sphere2_center);
+
+    if (distance >= (sphere1_radius + sphere2_radius)) {
+        return 0.0;
+    }
+
+    if (distance <= abs(sphere1_radius - sphere2_radius)) {
+        return 1.0;
+    }
+
+    float d = (sphere1_radius * sphere1_radius - sphere2_radius * sphere2_radius + distance * distance) / (2.0 * distance);
+
+    float area1 = acos(d / sphere1_radius) * sphere1_radius * sphere1_radius - d * sqrt(sphere1_radius * sphere1_radius - d * d);
+    float area2 = acos((distance - d) / sphere2_radius) * sphere2_radius * sphere2_radius - (distance - d) * sqrt(sphere2_radius * sphere2_radius - (distance - d) * (distance - d));
+
+    return (area1 + area2) / (3.14159265359 * (sphere1_radius * sphere1_radius + sphere2_radius * sphere2_radius));
+}
+
+// cell of the binning grid a light-space position falls into, positions
+// outside the grid bounds are clamped to the border cells
+ivec2 gridCell(vec2 position, vec4 gridBounds, uint gridSize) {
+    vec2 normalized = (position - gridBounds.xy) / (gridBounds.zw - gridBounds.xy);
+    return clamp(ivec2(floor(normalized * float(gridSize))), ivec2(0), ivec2(int(gridSize) - 1));
+}
\ No newline at end of file
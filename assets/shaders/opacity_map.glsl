@@ -0,0 +1,63 @@
+// resources shared by the opacity map passes, the splat pipeline and both
+// compute pipelines bind the same descriptor set layout and push constants
+
+#define OPACITY_MAP_SLICES 4
+
+// only the range pass writes the depth range, the others declare it readonly
+// so the vertex stage needs no store support
+#ifndef DEPTH_RANGE_ACCESS
+#define DEPTH_RANGE_ACCESS readonly
+#endif
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+// only the receiver pass writes shadows, the vertex stage must not see a
+// writable buffer
+#ifdef OPACITY_MAP_SHADOWS
+layout(std430, set = 0, binding = 1) writeonly buffer sbShadows {
+  float shadows[];
+};
+#endif
+
+// depthKey of the nearest and ~depthKey of the farthest particle center, both
+// reduced with atomicMin
+layout(std430, set = 0, binding = 2) DEPTH_RANGE_ACCESS buffer sbDepthRange {
+  uint depthRange[2];
+};
+
+// optical depth in front of the far end of every depth slice, one slice per
+// channel
+layout(set = 0, binding = 3) uniform sampler2D opacityMap;
+
+// Fourier coefficients of the absorption over depth, a0, a1, b1, a2 in the
+// first map and b2, a3, b3 in the second
+layout(set = 0, binding = 4) uniform sampler2D fourierMap0;
+layout(set = 0, binding = 5) uniform sampler2D fourierMap1;
+
+layout(push_constant) uniform PushConstants {
+    vec4 sunDir;
+    float extent;
+    uint particleCount;
+    float occlusionScale;
+    float minTransmittance;
+} pushConstants;
+
+// light-space xy in [-extent, extent] covers the map
+vec2 mapPosition(vec2 position) {
+    return position / pushConstants.extent;
+}
+
+// 0 at the particle nearest to the light, 1 at the farthest
+float normalizedDepth(float depth) {
+    float nearest = depthFromKey(depthRange[0]);
+    float farthest = depthFromKey(~depthRange[1]);
+    float range = max(farthest - nearest, 1e-6);
+    return clamp((depth - nearest) / range, 0.0, 1.0);
+}
+
+// continuous slice coordinate, slice i spans [i, i + 1)
+float sliceCoordinate(float depth) {
+    return normalizedDepth(depth) * float(OPACITY_MAP_SLICES);
+}
\ No newline at end of file
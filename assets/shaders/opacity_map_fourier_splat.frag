@@ -0,0 +1,20 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "opacity_map_splat.glsl"
+
+layout(location = 0) out vec4 outCoefficients0;
+layout(location = 1) out vec4 outCoefficients1;
+
+// blended additively, the particle is a delta of absorption at its depth and
+// adds its Fourier coefficients up to the third frequency
+void main() {
+    float absorption = 2.0 * splatOpticalDepth();
+    float phase = 2.0 * 3.14159265359 * inDepth;
+
+    vec3 cosines = cos(vec3(1.0, 2.0, 3.0) * phase);
+    vec3 sines = sin(vec3(1.0, 2.0, 3.0) * phase);
+
+    outCoefficients0 = absorption * vec4(1.0, cosines.x, sines.x, cosines.y);
+    outCoefficients1 = absorption * vec4(sines.y, cosines.z, sines.z, 0.0);
+}
\ No newline at end of file
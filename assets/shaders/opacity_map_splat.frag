@@ -0,0 +1,15 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "opacity_map_splat.glsl"
+
+layout(location = 0) out vec4 outOpticalDepth;
+
+// blended additively, a particle counts in its own slice and every slice
+// behind it
+void main() {
+    float opticalDepth = splatOpticalDepth();
+    int slice = min(int(inDepth * float(OPACITY_MAP_SLICES)), OPACITY_MAP_SLICES - 1);
+
+    outOpticalDepth = vec4(greaterThanEqual(ivec4(0, 1, 2, 3), ivec4(slice))) * opticalDepth;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+// fragment side of opacity_map_splat.vert, shared by the encodings
+
+#define OPACITY_MAP_SLICES 4
+
+layout(location = 0) in vec2 inCorner;
+layout(location = 1) in flat float inOcclusion;
+layout(location = 2) in flat float inDepth;
+
+// optical depth the particle adds at this texel, discards outside of its
+// reach
+float splatOpticalDepth() {
+    // center distance in radii, the quad spans two of them
+    float x = 2.0 * length(inCorner);
+    if (x >= 2.0) {
+        discard;
+    }
+
+    // circleOverlap of two discs of the same radius x radii apart, receivers
+    // of other sizes are approximated by it
+    float overlap = (2.0 * acos(0.5 * x) - 0.5 * x * sqrt(4.0 - x * x)) / (2.0 * 3.14159265359);
+
+    // -log of what the particle lets through, so that the map sums optical
+    // depths and the product of transmittances becomes a sum
+    return -log(max(1.0 - inOcclusion * overlap, 1e-6));
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "light_space.glsl"
+#include "opacity_map.glsl"
+
+layout(location = 0) out vec2 outCorner;
+layout(location = 1) out flat float outOcclusion;
+layout(location = 2) out flat float outDepth;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+// one quad per instance, twice the particle's radius so that it covers every
+// receiver center of the same size whose disc overlaps it. Shared by the
+// slice and the Fourier encodings
+void main() {
+    Particle particle = particles[gl_InstanceIndex];
+
+    mat4 lightMVP = lightMatrix(pushConstants.sunDir.xyz);
+    vec3 position = (lightMVP * vec4(particle.pos, 1.0)).xyz;
+
+    vec2 corner = corners[gl_VertexIndex];
+    outCorner = corner;
+    outOcclusion = pushConstants.occlusionScale * particle.opacity;
+    outDepth = normalizedDepth(position.z);
+
+    gl_Position = vec4(mapPosition(position.xy + corner * 2.0 * particle.radius), 0.0, 1.0);
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #version 450
 
+layout(location = 0) in flat uint inShadowIndex;
+layout(location = 1) in flat float inOpacity;
+
 layout(location = 0) out vec4 outFragColor;
 
 layout (std430, set = 1, binding = 0) readonly buffer sbShadows
@@ -7,13 +10,7 @@ layout (std430, set = 1, binding = 0) readonly buffer sbShadows
 	float shadows[];
 };
 
-layout(push_constant) uniform PushConstants {
-    mat4 model;
-    uint shadow_index;
-    float opacity;
-} pushConstants;
-
 void main() { 
-    float shadow = max(shadows[pushConstants.shadow_index], 0.25);
-    outFragColor = vec4(vec3(shadow), pushConstants.opacity);
+    float shadow = max(shadows[inShadowIndex], 0.25);
+    outFragColor = vec4(vec3(shadow), inOpacity);
 }
\ No newline at end of file
@@ -2,16 +2,42 @@
 
 layout(location = 0) in vec3 inPosition;
 
+layout(location = 0) out flat uint outShadowIndex;
+layout(location = 1) out flat float outOpacity;
+
 layout(set = 0, binding = 0) uniform GlobalUBO {
     mat4 projection;
     mat4 view;
 } globalUBO;
 
+struct Particle {
+  vec3 pos;
+  float _pad0;
+  float radius;
+  float opacity;
+  vec2 _pad1;
+};
+
+layout(std140, set = 1, binding = 1) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+// the particles picked for this draw's LOD by particle_lod.comp
+layout(std430, set = 2, binding = 0) readonly buffer sbInstances {
+  uint instances[];
+};
+
 layout(push_constant) uniform PushConstants {
-    mat4 model;
-    uint shadow_index;
+    uint instanceBase;
 } pushConstants;
 
 void main() {
-    gl_Position = globalUBO.projection * globalUBO.view * pushConstants.model * vec4(inPosition, 1.0);
+    uint index = instances[pushConstants.instanceBase + gl_InstanceIndex];
+    Particle particle = particles[index];
+    vec3 position = particle.pos + inPosition * particle.radius;
+
+    outShadowIndex = index;
+    outOpacity = particle.opacity;
+
+    gl_Position = globalUBO.projection * globalUBO.view * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+// resources shared by the particle_binning_* passes, every pass binds the same
+// descriptor set layout and push constant range
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer sbShadows {
+  float shadows[];
+};
+
+layout(std430, set = 0, binding = 2) buffer sbCellCounts {
+  uint cellCounts[];
+};
+
+layout(std430, set = 0, binding = 3) buffer sbCellOffsets {
+  uint cellOffsets[];
+};
+
+// cell and slot inside the cell of every particle
+layout(std430, set = 0, binding = 4) buffer sbParticleCells {
+  uvec2 particleCells[];
+};
+
+// light-space xy and radius, ordered by cell
+layout(std430, set = 0, binding = 5) buffer sbBinned {
+  vec4 binned[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec4 sunDir;
+    vec4 gridBounds;
+    uint particleCount;
+    uint gridSize;
+    float maxRadius;
+} pushConstants;
+
+vec2 lightPosition(mat4 lightMVP, vec3 position) {
+    return (lightMVP * vec4(position, 1.0)).xy;
+}
+
+uint cellIndex(ivec2 cell) {
+    return uint(cell.y) * pushConstants.gridSize + uint(cell.x);
+}
\ No newline at end of file
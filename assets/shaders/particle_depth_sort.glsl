@@ -0,0 +1,51 @@
+// resources shared by the depth-sorted shadowing passes. The radix sort
+// ping-pongs between two key/value buffer pairs, each frame has two
+// descriptor sets with the pairs bound in opposite order
+
+#define SORT_GROUP_SIZE 256
+#define RADIX_SIZE 256
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer sbShadows {
+  float shadows[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer sbKeysIn {
+  uint keysIn[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer sbValuesIn {
+  uint valuesIn[];
+};
+
+layout(std430, set = 0, binding = 4) writeonly buffer sbKeysOut {
+  uint keysOut[];
+};
+
+layout(std430, set = 0, binding = 5) writeonly buffer sbValuesOut {
+  uint valuesOut[];
+};
+
+// digit-major, histogram[digit * groupCount + group]
+layout(std430, set = 0, binding = 6) buffer sbHistogram {
+  uint histogram[];
+};
+
+// light-space xy, radius and opacity by particle index
+layout(std430, set = 0, binding = 7) buffer sbLightData {
+  vec4 lightData[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec4 sunDir;
+    uint particleCount;
+    uint shift;
+    float minTransmittance;
+} pushConstants;
+
+uint sortGroupCount() {
+    return (pushConstants.particleCount + SORT_GROUP_SIZE - 1) / SORT_GROUP_SIZE;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 450
+
+layout(location = 0) in vec3 inViewPosition;
+layout(location = 1) in flat vec3 inCenter;
+layout(location = 2) in flat float inRadius;
+layout(location = 3) in flat uint inShadowIndex;
+layout(location = 4) in flat float inOpacity;
+
+layout(location = 0) out vec4 outFragColor;
+
+// the front of the sphere is never behind the quad through its center, which
+// keeps early depth rejection against the quad's own depth
+layout(depth_less) out float gl_FragDepth;
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+    mat4 projection;
+    mat4 view;
+} globalUBO;
+
+layout (std430, set = 1, binding = 0) readonly buffer sbShadows
+{
+	float shadows[];
+};
+
+void main() {
+    // view space ray from the eye through this fragment of the quad
+    vec3 direction = normalize(inViewPosition);
+    float b = dot(direction, inCenter);
+    float c = dot(inCenter, inCenter) - inRadius * inRadius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.0) {
+        discard;
+    }
+
+    // the depth of the sphere, not of the quad, so overlapping particles
+    // intersect the way the meshes do
+    vec3 hit = direction * (b - sqrt(discriminant));
+    vec4 clip = globalUBO.projection * vec4(hit, 1.0);
+    gl_FragDepth = clip.z / clip.w;
+
+    float shadow = max(shadows[inShadowIndex], 0.25);
+    outFragColor = vec4(vec3(shadow), inOpacity);
+}
\ No newline at end of file
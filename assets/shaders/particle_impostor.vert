@@ -0,0 +1,58 @@
+#version 450
+
+layout(location = 0) out vec3 outViewPosition;
+layout(location = 1) out flat vec3 outCenter;
+layout(location = 2) out flat float outRadius;
+layout(location = 3) out flat uint outShadowIndex;
+layout(location = 4) out flat float outOpacity;
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+    mat4 projection;
+    mat4 view;
+} globalUBO;
+
+struct Particle {
+  vec3 pos;
+  float _pad0;
+  float radius;
+  float opacity;
+  vec2 _pad1;
+};
+
+layout(std140, set = 1, binding = 1) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+// one quad per instance and no vertex buffer. The quad faces the eye rather
+// than the view plane, it is then perpendicular to the axis of the sphere's
+// silhouette cone and only has to cover the cone's circular cross-section
+// through the center, which is wider than the sphere itself
+void main() {
+    Particle particle = particles[gl_InstanceIndex];
+    vec3 center = (globalUBO.view * vec4(particle.pos, 1.0)).xyz;
+
+    float distance2 = max(dot(center, center), 1e-8);
+    vec3 axis = center * inversesqrt(distance2);
+    vec3 up = abs(axis.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, axis));
+    up = cross(axis, right);
+
+    // the eye inside the sphere would need an infinite quad, it is clamped
+    float radius = particle.radius;
+    float extent = radius * inversesqrt(max(1.0 - radius * radius / distance2, 1e-4));
+
+    vec2 corner = corners[gl_VertexIndex];
+    vec3 position = center + (corner.x * right + corner.y * up) * extent;
+
+    outViewPosition = position;
+    outCenter = center;
+    outRadius = radius;
+    outShadowIndex = gl_InstanceIndex;
+    outOpacity = particle.opacity;
+
+    gl_Position = globalUBO.projection * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+// resources shared by the incremental shadow passes, all of them bind the same
+// descriptor set layout and push constant range
+
+#define INCREMENTAL_GROUP_SIZE 256
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer sbShadows {
+  float shadows[];
+};
+
+// light-space xy, radius and opacity of every particle as of the last time it
+// moved by more than the epsilon
+layout(std430, set = 0, binding = 2) buffer sbTracked {
+  vec4 tracked[];
+};
+
+// shadows of the last solve, kept across frames
+layout(std430, set = 0, binding = 3) buffer sbCached {
+  float cached[];
+};
+
+// non-zero for the grid cells a moved particle can shade
+layout(std430, set = 0, binding = 4) buffer sbDirtyCells {
+  uint dirtyCells[];
+};
+
+// indices of the receivers to recompute this frame, packed so that the
+// shadowing pass only launches workgroups of dirty receivers
+layout(std430, set = 0, binding = 5) buffer sbDirtyReceivers {
+  uint dirtyReceivers[];
+};
+
+// a VkDispatchIndirectCommand over dirtyReceivers, followed by their count
+layout(std430, set = 0, binding = 6) buffer sbDispatch {
+  uint groupCountX;
+  uint groupCountY;
+  uint groupCountZ;
+  uint dirtyReceiverCount;
+};
+
+layout(push_constant) uniform PushConstants {
+    vec4 sunDir;
+    vec4 gridBounds;
+    uint particleCount;
+    uint gridSize;
+    float maxRadius;
+    float epsilon;
+    uint fullRefresh;
+} pushConstants;
+
+uint cellIndex(ivec2 cell) {
+    return uint(cell.y) * pushConstants.gridSize + uint(cell.x);
+}
\ No newline at end of file
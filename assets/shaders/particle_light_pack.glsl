@@ -0,0 +1,16 @@
+// projects every particle into light space once, so the shadow pass reads
+// PACKED_TYPE instead of the 32-byte Particle
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= pushConstants.particleCount) {
+    return;
+  }
+
+  Particle particle = particles[index];
+
+  mat4 lightMVP = lightMatrix(pushConstants.sunDir.xyz);
+  vec2 position = (lightMVP * vec4(particle.pos, 1.0)).xy;
+
+  packedParticles[index] = PACKED_TYPE(vec4(position, particle.radius, particle.opacity));
+}
\ No newline at end of file
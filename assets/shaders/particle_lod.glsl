@@ -0,0 +1,81 @@
+// resources shared by the particle LOD passes, see src/particle_lod.h
+
+#define LOD_GROUP_SIZE 128
+// mirrored by SPHERE_LOD_COUNT in src/geometry.h, the sorted passes count
+// the LODs in the components of a uvec4
+#define LOD_COUNT 4
+// mirrored by PARTICLE_MAX_RADIUS in src/particle_system.h
+#define PARTICLE_MAX_RADIUS 0.5
+
+struct DrawIndexedIndirectCommand {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+// mirrors LodDraws. draws are reset by the host every frame, visibleDraws
+// are the non-empty ones packed for vkCmdDrawIndexedIndirectCount
+layout(std430, set = 0, binding = 1) buffer sbDraws {
+  DrawIndexedIndirectCommand draws[LOD_COUNT];
+  DrawIndexedIndirectCommand visibleDraws[LOD_COUNT];
+  uint visibleDrawCount;
+};
+
+// the particles drawn with LOD i start at i * lodCapacity
+layout(std430, set = 0, binding = 2) writeonly buffer sbInstances {
+  uint instances[];
+};
+
+// per workgroup of the sorted passes, how many particles of every LOD it
+// holds and then, scanned, where they start in their LOD's list
+layout(std430, set = 0, binding = 3) buffer sbBlockOffsets {
+  uvec4 blockOffsets[];
+};
+
+// ParticleSort's back to front permutation, only bound when sorted
+layout(std430, set = 1, binding = 0) readonly buffer sbOrder {
+  uint order[];
+};
+
+layout(push_constant) uniform PushConstants {
+    // world space, pointing inwards
+    vec4 frustumPlanes[6];
+    // xyz: the eye, w: projection[1][1] * half the viewport height, turns a
+    // radius over distance into pixels
+    vec4 eye;
+    uint particleCount;
+    uint lodCapacity;
+    uint backToFront;
+} pushConstants;
+
+// smallest projected radius in pixels each LOD is drawn at, finest first
+const float lodMinPixels[LOD_COUNT] = float[](48.0, 16.0, 6.0, 0.0);
+
+// false for particles outside of the frustum, they get no instance at all.
+// Back to front the LOD only depends on the distance to the eye, picked as if
+// every particle had the largest radius. The LODs are then bands of the
+// distance ParticleSort orders by and drawing them coarsest first keeps the
+// order exact
+bool particleLod(Particle particle, out uint lod) {
+  lod = 0;
+  for (uint i = 0; i < 6; i++) {
+    vec4 plane = pushConstants.frustumPlanes[i];
+    if (dot(plane.xyz, particle.pos) + plane.w < -particle.radius) {
+      return false;
+    }
+  }
+
+  float distance = max(length(particle.pos - pushConstants.eye.xyz), 1e-4);
+  float radius = pushConstants.backToFront != 0 ? PARTICLE_MAX_RADIUS : particle.radius;
+  float pixels = pushConstants.eye.w * radius / distance;
+  while (lod < LOD_COUNT - 1 && pixels < lodMinPixels[lod]) {
+    lod++;
+  }
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+// resources shared by the packed shadow passes. PACKED_TYPE is f16vec4 when
+// the device has 16-bit storage buffer access, vec4 otherwise
+
+#ifndef PACKED_TYPE
+#define PACKED_TYPE vec4
+#endif
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer sbShadows {
+  float shadows[];
+};
+
+// light-space xy, radius and opacity of every particle
+layout(std430, set = 0, binding = 2) buffer sbPacked {
+  PACKED_TYPE packedParticles[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec4 sunDir;
+    uint particleCount;
+} pushConstants;
\ No newline at end of file
@@ -0,0 +1,46 @@
+// particle_shadowing.comp over the packed particles, the math stays in fp32
+
+// light-space xy and radius of TILE_SIZE occluders, loaded cooperatively
+shared vec4 sharedData[TILE_SIZE];
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+
+  // invocations past the end still help loading tiles, every invocation has
+  // to reach the barriers
+  bool active = index < pushConstants.particleCount;
+
+  vec4 current = vec4(0.0);
+  if (active) {
+    current = vec4(packedParticles[index]);
+  }
+
+  float shadow = 0.0;
+
+  for (uint tile = 0; tile < pushConstants.particleCount; tile += TILE_SIZE) {
+    for (uint slot = gl_LocalInvocationID.x; slot < TILE_SIZE; slot += gl_WorkGroupSize.x) {
+      uint other = tile + slot;
+      if (other < pushConstants.particleCount) {
+        sharedData[slot] = vec4(packedParticles[other]);
+      }
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if (active) {
+      uint tileSize = min(TILE_SIZE, pushConstants.particleCount - tile);
+      for (uint j = 0; j < tileSize; j++) {
+        vec4 occluder = sharedData[j];
+        shadow += circleOverlap(current.xy, current.z, occluder.xy, occluder.z) * 0.1 * current.w;
+      }
+    }
+
+    memoryBarrierShared();
+    barrier();
+  }
+
+  if (active) {
+    shadows[index] = 1 - shadow;
+  }
+}
\ No newline at end of file
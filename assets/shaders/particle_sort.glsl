@@ -0,0 +1,26 @@
+// resources shared by the back to front sort passes, see src/particle_sort.h
+
+#define SORT_GROUP_SIZE 256
+// elements a workgroup sorts in shared memory, two per invocation
+#define SORT_BLOCK_SIZE 512
+
+layout(std140, set = 0, binding = 0) readonly buffer sbParticles {
+  Particle particles[];
+};
+
+// the permutation being sorted, kept from frame to frame
+layout(std430, set = 0, binding = 1) buffer sbOrder {
+  uint order[];
+};
+
+// by particle index, ascending keys are back to front
+layout(std430, set = 0, binding = 2) buffer sbKeys {
+  uint keys[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec4 eye;
+    uint particleCount;
+    // where the pass' first block starts, 0 or half a block
+    uint offset;
+} pushConstants;
\ No newline at end of file
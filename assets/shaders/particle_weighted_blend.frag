@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) in flat uint inShadowIndex;
+layout(location = 1) in flat float inOpacity;
+
+// weighted premultiplied color and weighted coverage, summed
+layout(location = 0) out vec4 outAccumulation;
+// coverage, the target keeps the product of (1 - coverage)
+layout(location = 1) out float outRevealage;
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+    mat4 projection;
+    mat4 view;
+} globalUBO;
+
+layout (std430, set = 1, binding = 0) readonly buffer sbShadows
+{
+	float shadows[];
+};
+
+void main() {
+    float shadow = max(shadows[inShadowIndex], 0.25);
+    vec3 color = vec3(shadow);
+    float alpha = inOpacity;
+
+    // the projection inverted for the view depth, near fragments weigh more
+    // so that they dominate the average like they would when sorted. The
+    // camera uses glm's left-handed, -1 to 1 perspective, Vulkan takes its
+    // clip z / w unchanged as the depth, so depth = P22 + P32 / viewDepth.
+    // The weight function is McGuire and Bavoil's, tuned for scenes up to a
+    // few hundred units deep
+    float viewDepth = globalUBO.projection[3][2] / (gl_FragCoord.z - globalUBO.projection[2][2]);
+    float weight = alpha * clamp(0.03 / (1e-5 + pow(abs(viewDepth) / 200.0, 4.0)), 1e-2, 3e3);
+
+    outAccumulation = vec4(color * alpha, alpha) * weight;
+    outRevealage = alpha;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 450
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput inAccumulation;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput inRevealage;
+
+layout(location = 0) out vec4 outFragColor;
+
+// the weighted average color, blended over the background by the coverage
+// of everything drawn on top of it
+void main() {
+    float revealage = subpassLoad(inRevealage).r;
+    if (revealage == 1.0) {
+        discard;
+    }
+
+    vec4 accumulation = subpassLoad(inAccumulation);
+    vec3 average = accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4);
+
+    outFragColor = vec4(average, 1.0 - revealage);
+}
\ No newline at end of file
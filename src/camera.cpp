@@ -46,6 +46,27 @@ glm::mat4 Camera::getViewMatrix() {
   return view;
 }
 
+void Camera::getFrustumPlanes(glm::vec4 *out_planes) {
+  glm::mat4 view_projection = getProjectionMatrix() * getViewMatrix();
+  glm::vec4 rows[4];
+  for (u32 i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i],
+                        view_projection[2][i], view_projection[3][i]);
+  }
+
+  /* glm clips depth to -1..1 unless GLM_FORCE_DEPTH_ZERO_TO_ONE, the near
+   * plane is then w + z like the others */
+  out_planes[0] = rows[3] + rows[0];
+  out_planes[1] = rows[3] - rows[0];
+  out_planes[2] = rows[3] + rows[1];
+  out_planes[3] = rows[3] - rows[1];
+  out_planes[4] = rows[3] + rows[2];
+  out_planes[5] = rows[3] - rows[2];
+  for (u32 i = 0; i < 6; ++i) {
+    out_planes[i] /= glm::length(glm::vec3(out_planes[i]));
+  }
+}
+
 glm::vec3 Camera::getUp() {
   return glm::rotate(getOrientation(), glm::vec3(0.0f, 1.0f, 0.0f));
 }
@@ -23,6 +23,9 @@ struct Camera {
 
   glm::mat4 getProjectionMatrix();
   glm::mat4 getViewMatrix();
+  /* left, right, bottom, top, near and far planes in world space, normalized
+   * and pointing inwards */
+  void getFrustumPlanes(glm::vec4 *out_planes);
 
   glm::vec3 getUp();
   glm::vec3 getRight();
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "platform.h"
+
+#include <cstddef>
+#include <new>
+
+/* std::vector allocator that places the storage on an `Alignment` byte
+ * boundary, used for streams that are processed with SIMD loads */
+template <typename T, u64 Alignment> struct AlignedAllocator {
+  typedef T value_type;
+
+  template <typename U> struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+  T *allocate(std::size_t count) {
+    return (T *)::operator new(count * sizeof(T),
+                               std::align_val_t(Alignment));
+  }
+
+  void deallocate(T *pointer, std::size_t) {
+    ::operator delete(pointer, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  b8 operator==(const AlignedAllocator<U, Alignment> &) const {
+    return true;
+  }
+  template <typename U>
+  b8 operator!=(const AlignedAllocator<U, Alignment> &) const {
+    return false;
+  }
+};
\ No newline at end of file
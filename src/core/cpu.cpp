@@ -0,0 +1,64 @@
+#include "cpu.h"
+
+#include "logger.h"
+
+#ifdef ARCH_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+static b8 avx2_supported = false;
+
+#ifdef ARCH_X64
+static void cpuid(u32 leaf, u32 subleaf, u32 *out_registers) {
+#ifdef _MSC_VER
+  i32 registers[4];
+  __cpuidex(registers, leaf, subleaf);
+  for (u32 i = 0; i < 4; ++i) {
+    out_registers[i] = registers[i];
+  }
+#else
+  __cpuid_count(leaf, subleaf, out_registers[0], out_registers[1],
+                out_registers[2], out_registers[3]);
+#endif
+}
+
+static u64 xgetbv(u32 index) {
+#ifdef _MSC_VER
+  return _xgetbv(index);
+#else
+  u32 eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+  return ((u64)edx << 32) | eax;
+#endif
+}
+#endif
+
+b8 Cpu::initialize() {
+#ifdef ARCH_X64
+  u32 registers[4];
+  cpuid(0, 0, registers);
+  u32 max_leaf = registers[0];
+
+  cpuid(1, 0, registers);
+  b8 osxsave = registers[2] & (1 << 27);
+  b8 avx = registers[2] & (1 << 28);
+
+  /* the OS has to save the ymm registers on context switch as well */
+  b8 ymm_enabled = osxsave && (xgetbv(0) & 0x6) == 0x6;
+
+  if (max_leaf >= 7 && avx && ymm_enabled) {
+    cpuid(7, 0, registers);
+    avx2_supported = registers[1] & (1 << 5);
+  }
+#endif
+
+  DEBUG("CPU features: AVX2 %s", avx2_supported ? "yes" : "no");
+
+  return true;
+}
+
+b8 Cpu::hasAVX2() { return avx2_supported; }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "platform.h"
+
+/* TARGET_* marks a function that is compiled for a newer instruction set than
+ * the rest of the binary, callers must check Cpu::has* before calling it */
+#if defined(ARCH_X64) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+struct Cpu {
+  static b8 initialize();
+
+  static b8 hasAVX2();
+};
\ No newline at end of file
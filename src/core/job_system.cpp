@@ -0,0 +1,191 @@
+#include "job_system.h"
+
+#include "logger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job {
+  const ParallelForFunction *function;
+  u32 begin;
+  u32 end;
+  std::atomic<u32> *remaining;
+};
+
+struct WorkQueue {
+  std::mutex mutex;
+  std::deque<Job> jobs;
+
+  void push(const Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+  }
+
+  b8 pop(Job *out_job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) {
+      return false;
+    }
+
+    *out_job = jobs.back();
+    jobs.pop_back();
+
+    return true;
+  }
+
+  b8 steal(Job *out_job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) {
+      return false;
+    }
+
+    *out_job = jobs.front();
+    jobs.pop_front();
+
+    return true;
+  }
+};
+
+static std::vector<std::thread> workers;
+/* queue 0 belongs to the thread that called initialize */
+static std::vector<WorkQueue> queues;
+static std::atomic<b8> running;
+static std::atomic<u32> pending_jobs;
+static std::mutex wake_mutex;
+static std::condition_variable wake_condition;
+
+static thread_local u32 thread_index = 0;
+
+static b8 jobFind(u32 queue_index, Job *out_job);
+static void jobExecute(const Job &job);
+static void workerLoop(u32 queue_index);
+
+b8 JobSystem::initialize(u32 worker_count) {
+  if (worker_count == 0) {
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+  }
+
+  running = true;
+  pending_jobs = 0;
+  queues = std::vector<WorkQueue>(worker_count + 1);
+
+  thread_index = 0;
+  for (u32 i = 0; i < worker_count; ++i) {
+    workers.emplace_back(workerLoop, i + 1);
+  }
+
+  INFO("Job system: %u worker threads", worker_count);
+
+  return true;
+}
+
+void JobSystem::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    running = false;
+  }
+  wake_condition.notify_all();
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  workers.clear();
+  queues.clear();
+}
+
+void JobSystem::parallelFor(u32 count, u32 chunk_size,
+                            const ParallelForFunction &function) {
+  if (count == 0) {
+    return;
+  }
+
+  if (chunk_size == 0) {
+    chunk_size = 1;
+  }
+
+  u32 chunk_count = (count + chunk_size - 1) / chunk_size;
+  if (chunk_count == 1 || queues.size() <= 1) {
+    function(0, count);
+    return;
+  }
+
+  std::atomic<u32> remaining = chunk_count;
+
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    pending_jobs += chunk_count;
+  }
+
+  /* spread the chunks over every deque so that the workers start without
+   * having to steal */
+  for (u32 i = 0; i < chunk_count; ++i) {
+    Job job;
+    job.function = &function;
+    job.begin = i * chunk_size;
+    job.end = job.begin + chunk_size < count ? job.begin + chunk_size : count;
+    job.remaining = &remaining;
+
+    queues[(thread_index + i) % queues.size()].push(job);
+  }
+
+  wake_condition.notify_all();
+
+  while (remaining.load(std::memory_order_acquire) != 0) {
+    Job job;
+    if (jobFind(thread_index, &job)) {
+      jobExecute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+u32 JobSystem::getThreadCount() { return queues.size(); }
+
+static b8 jobFind(u32 queue_index, Job *out_job) {
+  if (queues[queue_index].pop(out_job)) {
+    return true;
+  }
+
+  for (u32 i = 1; i < queues.size(); ++i) {
+    u32 victim = (queue_index + i) % queues.size();
+    if (queues[victim].steal(out_job)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void jobExecute(const Job &job) {
+  pending_jobs.fetch_sub(1, std::memory_order_relaxed);
+
+  (*job.function)(job.begin, job.end);
+
+  job.remaining->fetch_sub(1, std::memory_order_release);
+}
+
+static void workerLoop(u32 queue_index) {
+  thread_index = queue_index;
+
+  while (true) {
+    Job job;
+    if (jobFind(queue_index, &job)) {
+      jobExecute(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake_condition.wait(lock,
+                        [] { return !running || pending_jobs.load() > 0; });
+    if (!running) {
+      return;
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "platform.h"
+
+#include <functional>
+
+typedef std::function<void(u32 begin, u32 end)> ParallelForFunction;
+
+/* fixed pool of worker threads, each owning a deque of jobs; idle workers
+ * steal from the front of the other deques while owners pop from the back */
+struct JobSystem {
+  /* worker_count of 0 uses one worker per hardware thread minus the caller */
+  static b8 initialize(u32 worker_count);
+  static void shutdown();
+
+  /* splits [0, count) into chunks of chunk_size and runs them on the pool,
+   * the calling thread takes part and returns once every chunk is done */
+  static void parallelFor(u32 count, u32 chunk_size,
+                          const ParallelForFunction &function);
+
+  static u32 getThreadCount();
+};
\ No newline at end of file
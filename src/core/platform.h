@@ -46,4 +46,8 @@ typedef double f64;
 #endif
 #else
 #error "Unknown platform!"
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ARCH_X64 1
 #endif
\ No newline at end of file
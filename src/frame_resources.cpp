@@ -0,0 +1,164 @@
+#include "frame_resources.h"
+
+#include "core/logger.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+
+b8 FrameResources::create(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator,
+                          u32 particle_capacity) {
+  if (!global_uniform_buffer.create(allocator, sizeof(GlobalUBO),
+                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                    VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                    VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+    ERROR("Failed to create a global uniform buffer!");
+    return false;
+  }
+
+  VkDescriptorBufferInfo global_ubo_buffer_info =
+      vulkanDescriptorBufferInfo(&global_uniform_buffer);
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  builder.bufferBind(0, &global_ubo_buffer_info,
+                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                     VK_SHADER_STAGE_VERTEX_BIT |
+                         VK_SHADER_STAGE_FRAGMENT_BIT);
+  if (!builder.end(device, &global_ubo_descriptor_set)) {
+    ERROR("Failed to build a global descriptor set!");
+    return false;
+  }
+
+  if (!light_uniform_buffer.create(allocator, sizeof(LightUBO),
+                                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                   VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                   VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+    ERROR("Failed to create a light uniform buffer!");
+    return false;
+  }
+
+  VkDescriptorBufferInfo light_ubo_buffer_info =
+      vulkanDescriptorBufferInfo(&light_uniform_buffer);
+
+  builder = {};
+  builder.begin();
+  builder.bufferBind(0, &light_ubo_buffer_info,
+                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                     VK_SHADER_STAGE_COMPUTE_BIT);
+  if (!builder.end(device, &light_ubo_descriptor_set)) {
+    ERROR("Failed to build a light descriptor set!");
+    return false;
+  }
+
+  return createParticleBuffers(device, allocator, particle_capacity, false);
+}
+
+void FrameResources::destroy(VulkanMemoryAllocator *allocator) {
+  destroyParticleBuffers(allocator);
+  light_uniform_buffer.destroy(allocator);
+  global_uniform_buffer.destroy(allocator);
+}
+
+b8 FrameResources::reserve(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator,
+                           u32 particle_count) {
+  if (particle_count <= capacity) {
+    return true;
+  }
+
+  u32 new_capacity = capacity * 2;
+  if (new_capacity < particle_count) {
+    new_capacity = particle_count;
+  }
+
+  destroyParticleBuffers(allocator);
+  return createParticleBuffers(device, allocator, new_capacity, device_local);
+}
+
+b8 FrameResources::createParticleBuffers(VulkanDevice *device,
+                                         VulkanMemoryAllocator *allocator,
+                                         u32 particle_capacity,
+                                         b8 particles_device_local) {
+  capacity = particle_capacity;
+  device_local = particles_device_local;
+  generation++;
+
+  b8 particles_created;
+  if (device_local) {
+    particles_created = particles_buffer.create(
+        allocator, sizeof(Particle) * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+  } else {
+    particles_created = particles_buffer.create(
+        allocator, sizeof(Particle) * capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+        VMA_ALLOCATION_CREATE_MAPPED_BIT);
+  }
+  if (!particles_created) {
+    ERROR("Failed to create a particles buffer!");
+    return false;
+  }
+
+  if (!shadows_buffer.create(allocator, sizeof(f32) * capacity,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a shadows buffer!");
+    return false;
+  }
+
+  /* descriptor sets of the previous capacity are not freed individually, they
+   * go back to the pool on VulkanDescriptorAllocator::shutdown */
+  VkDescriptorBufferInfo particles_buffer_info =
+      vulkanDescriptorBufferInfo(&particles_buffer);
+  VkDescriptorBufferInfo shadows_buffer_info =
+      vulkanDescriptorBufferInfo(&shadows_buffer);
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  builder.bufferBind(0, &shadows_buffer_info,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_FRAGMENT_BIT);
+  builder.bufferBind(1, &particles_buffer_info,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_VERTEX_BIT);
+  if (!builder.end(device, &graphics_descriptor_set)) {
+    ERROR("Failed to build a graphics descriptor set!");
+    return false;
+  }
+
+  builder = {};
+  builder.begin();
+  builder.bufferBind(0, &particles_buffer_info,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_COMPUTE_BIT);
+  if (!builder.end(device, &compute_readonly_descriptor_set)) {
+    ERROR("Failed to build a compute descriptor set!");
+    return false;
+  }
+
+  builder = {};
+  builder.begin();
+  builder.bufferBind(0, &shadows_buffer_info,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_COMPUTE_BIT);
+  if (!builder.end(device, &compute_writeonly_descriptor_set)) {
+    ERROR("Failed to build a compute descriptor set!");
+    return false;
+  }
+
+  return true;
+}
+
+void FrameResources::destroyParticleBuffers(VulkanMemoryAllocator *allocator) {
+  particles_buffer.destroy(allocator);
+  shadows_buffer.destroy(allocator);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/platform.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_device.h"
+#include "renderer/vulkan/vulkan_memory_allocator.h"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+struct GlobalUBO {
+  glm::mat4 projection;
+  glm::mat4 view;
+};
+
+/* the light-space fit of the frame, see lightMatrixFitted */
+struct LightUBO {
+  glm::mat4 light_matrix;
+  f32 radius_scale;
+  f32 _pad[3];
+};
+
+/* everything a frame writes while the GPU may still be reading the previous
+ * ones, there is one per frame in flight. Particle storage is sized by
+ * capacity rather than by the current particle count so that the system can
+ * grow without reallocating every frame */
+struct FrameResources {
+  u32 capacity;
+  b8 device_local;
+  /* bumped whenever the particle buffers are recreated, lets other passes
+   * know their descriptor sets are stale */
+  u32 generation = 0;
+  VulkanBuffer global_uniform_buffer;
+  VulkanBuffer light_uniform_buffer;
+  VulkanBuffer particles_buffer;
+  VulkanBuffer shadows_buffer;
+  VkDescriptorSet global_ubo_descriptor_set;
+  VkDescriptorSet light_ubo_descriptor_set;
+  VkDescriptorSet graphics_descriptor_set;
+  VkDescriptorSet compute_readonly_descriptor_set;
+  VkDescriptorSet compute_writeonly_descriptor_set;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 particle_capacity);
+  void destroy(VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on */
+  b8 reserve(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             u32 particle_count);
+
+  /* device_local buffers are not host mapped, they are written by the GPU
+   * simulation instead of being uploaded every frame */
+  b8 createParticleBuffers(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator,
+                           u32 particle_capacity, b8 particles_device_local);
+  void destroyParticleBuffers(VulkanMemoryAllocator *allocator);
+};
\ No newline at end of file
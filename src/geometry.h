@@ -4,8 +4,19 @@
 
 #include <vector>
 
-std::vector<f32> generateSphereVertices(f32 radius, i32 sector_count,
-                                        i32 stack_count) {
+/* mirrored by LOD_COUNT in particle_lod.comp */
+#define SPHERE_LOD_COUNT 4
+
+/* one tessellation of the packed LOD chain, the fields line up with
+ * VkDrawIndexedIndirectCommand */
+struct SphereLod {
+  u32 index_count;
+  u32 first_index;
+  i32 vertex_offset;
+};
+
+inline std::vector<f32> generateSphereVertices(f32 radius, i32 sector_count,
+                                               i32 stack_count) {
   std::vector<f32> vertices;
 
   const f32 PI = acos(-1.0f);
@@ -41,7 +52,8 @@ std::vector<f32> generateSphereVertices(f32 radius, i32 sector_count,
   return vertices;
 }
 
-std::vector<u32> generateSphereIndices(i32 sector_count, i32 stack_count) {
+inline std::vector<u32> generateSphereIndices(i32 sector_count,
+                                              i32 stack_count) {
   std::vector<u32> indices;
 
   // indices
@@ -71,4 +83,27 @@ std::vector<u32> generateSphereIndices(i32 sector_count, i32 stack_count) {
   }
 
   return indices;
+}
+
+/* SPHERE_LOD_COUNT tessellations from finest to coarsest, packed one after the
+ * other into a single vertex and index buffer */
+inline void generateSphereLods(f32 radius, std::vector<f32> *vertices,
+                               std::vector<u32> *indices,
+                               SphereLod *out_lods) {
+  const i32 sector_counts[SPHERE_LOD_COUNT] = {36, 18, 10, 6};
+  const i32 stack_counts[SPHERE_LOD_COUNT] = {18, 9, 5, 3};
+
+  for (u32 i = 0; i < SPHERE_LOD_COUNT; ++i) {
+    std::vector<f32> lod_vertices =
+        generateSphereVertices(radius, sector_counts[i], stack_counts[i]);
+    std::vector<u32> lod_indices =
+        generateSphereIndices(sector_counts[i], stack_counts[i]);
+
+    out_lods[i].index_count = lod_indices.size();
+    out_lods[i].first_index = indices->size();
+    out_lods[i].vertex_offset = vertices->size() / 3;
+
+    vertices->insert(vertices->end(), lod_vertices.begin(), lod_vertices.end());
+    indices->insert(indices->end(), lod_indices.begin(), lod_indices.end());
+  }
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "gpu_simulation.h"
+
+#include "core/file_system.h"
+#include "core/logger.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_command_pool.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "renderer/vulkan/vulkan_queue.h"
+#include "renderer/vulkan/vulkan_shader_module.h"
+
+#include <cmath>
+
+b8 GpuSimulation::create(VulkanDevice *device) {
+  VulkanShaderModule shader_module;
+  if (!shader_module.create(
+          device,
+          FileSystem::joinPath("assets/shaders/particle_update.comp.spv")
+              .c_str())) {
+    ERROR("Failed to create a particle update shader module!");
+    return false;
+  }
+
+  /* binding 0: previous frame particles, binding 1: this frame particles,
+   * binding 2: velocities */
+  VkDescriptorSetLayoutBinding bindings[3];
+  for (u32 i = 0; i < 3; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = 3;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsSimulation);
+
+  VkPipelineShaderStageCreateInfo stage_create_info =
+      vulkanPipelineShaderStageCreateInfo(&shader_module,
+                                          VK_SHADER_STAGE_COMPUTE_BIT);
+
+  if (!pipeline.createCompute(device, 1, &descriptor_set_layout, 1,
+                              &push_constant_range, stage_create_info)) {
+    ERROR("Failed to create a particle update pipeline!");
+    return false;
+  }
+
+  shader_module.destroy(device);
+
+  return true;
+}
+
+void GpuSimulation::destroy(VulkanDevice *device,
+                            VulkanMemoryAllocator *allocator) {
+  if (enabled) {
+    velocities_buffer.destroy(allocator);
+  }
+
+  pipeline.destroy(device);
+}
+
+b8 GpuSimulation::enable(VulkanDevice *device,
+                         VulkanMemoryAllocator *allocator, VulkanQueue *queue,
+                         VulkanCommandPool *command_pool,
+                         ParticleSystem *particle_system,
+                         std::vector<FrameResources> &frames) {
+  device->waitIdle();
+
+  syncReference(particle_system);
+
+  if (enabled) {
+    velocities_buffer.destroy(allocator);
+    enabled = false;
+  }
+
+  u32 capacity = particle_system->count;
+
+  std::vector<Particle> particles(capacity);
+  particle_system->pack(particles.data(), 0, capacity);
+
+  for (u32 i = 0; i < frames.size(); ++i) {
+    frames[i].destroyParticleBuffers(allocator);
+    if (!frames[i].createParticleBuffers(device, allocator, capacity, true)) {
+      ERROR("Failed to create device-local particle buffers!");
+      return false;
+    }
+
+    if (!frames[i].particles_buffer.loadDataStaging(
+            device, allocator, particles.data(), queue, command_pool)) {
+      ERROR("Failed to upload particles!");
+      return false;
+    }
+  }
+
+  std::vector<glm::vec4> velocities(capacity);
+  for (u32 i = 0; i < capacity; ++i) {
+    velocities[i] = glm::vec4(particle_system->vx[i], particle_system->vy[i],
+                              particle_system->vz[i], 0.0f);
+  }
+
+  if (!velocities_buffer.create(allocator, sizeof(glm::vec4) * capacity,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a velocities buffer!");
+    return false;
+  }
+  if (!velocities_buffer.loadDataStaging(device, allocator, velocities.data(),
+                                         queue, command_pool)) {
+    ERROR("Failed to upload velocities!");
+    return false;
+  }
+
+  VkDescriptorBufferInfo velocities_buffer_info =
+      vulkanDescriptorBufferInfo(&velocities_buffer);
+
+  descriptor_sets.resize(frames.size());
+  for (u32 i = 0; i < frames.size(); ++i) {
+    u32 previous_index = (i + frames.size() - 1) % frames.size();
+
+    VkDescriptorBufferInfo previous_buffer_info =
+        vulkanDescriptorBufferInfo(&frames[previous_index].particles_buffer);
+    VkDescriptorBufferInfo current_buffer_info =
+        vulkanDescriptorBufferInfo(&frames[i].particles_buffer);
+
+    VulkanDescriptorSetBuilder builder;
+    builder.begin();
+    builder.bufferBind(0, &previous_buffer_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+    builder.bufferBind(1, &current_buffer_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+    builder.bufferBind(2, &velocities_buffer_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+    if (!builder.end(device, &descriptor_sets[i])) {
+      ERROR("Failed to build a simulation descriptor set!");
+      return false;
+    }
+  }
+
+  enabled = true;
+  pending_time = 0.0f;
+
+  return true;
+}
+
+b8 GpuSimulation::disable(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator,
+                          ParticleSystem *particle_system,
+                          std::vector<FrameResources> &frames) {
+  if (!enabled) {
+    return true;
+  }
+
+  device->waitIdle();
+
+  syncReference(particle_system);
+
+  for (u32 i = 0; i < frames.size(); ++i) {
+    frames[i].destroyParticleBuffers(allocator);
+    if (!frames[i].createParticleBuffers(device, allocator,
+                                         particle_system->count, false)) {
+      ERROR("Failed to create particle upload buffers!");
+      return false;
+    }
+  }
+
+  velocities_buffer.destroy(allocator);
+  enabled = false;
+
+  return true;
+}
+
+void GpuSimulation::syncReference(ParticleSystem *particle_system) {
+  if (pending_time > 0.0f) {
+    particle_system->update(pending_time);
+  }
+
+  pending_time = 0.0f;
+}
+
+void GpuSimulation::record(VulkanCommandBuffer *command_buffer,
+                           u32 frame_index, u32 particle_count,
+                           f32 delta_time) {
+  /* the previous frame's particles were written by an earlier submission on
+   * this queue, and this frame's buffer may still be read by one */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, &pipeline);
+  command_buffer->descriptorSetBind(&pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_sets[frame_index], 0, 0, 0);
+
+  PushConstantsSimulation push_constants;
+  push_constants.delta_time = delta_time;
+  push_constants.particle_count = particle_count;
+  command_buffer->pushConstants(&pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsSimulation),
+                                &push_constants);
+
+  command_buffer->dispatch(
+      (particle_count + SIMULATION_GROUP_SIZE - 1) / SIMULATION_GROUP_SIZE, 1);
+
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+  pending_time += delta_time;
+}
+
+b8 GpuSimulation::validate(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator,
+                           VulkanQueue *queue, VulkanCommandPool *command_pool,
+                           ParticleSystem *particle_system,
+                           std::vector<FrameResources> &frames,
+                           u32 last_frame_index) {
+  if (!enabled) {
+    return true;
+  }
+
+  device->waitIdle();
+
+  std::vector<Particle> particles(frames[last_frame_index].capacity);
+  if (!frames[last_frame_index].particles_buffer.readDataStaging(
+          device, allocator, particles.data(), queue, command_pool)) {
+    ERROR("Failed to read back particles!");
+    return false;
+  }
+
+  syncReference(particle_system);
+
+  f32 max_error = 0.0f;
+  for (u32 i = 0; i < particle_system->count; ++i) {
+    glm::vec3 difference =
+        particles[i].pos - particle_system->getPosition(i);
+    f32 error = fmaxf(fabsf(difference.x),
+                      fmaxf(fabsf(difference.y), fabsf(difference.z)));
+    max_error = fmaxf(max_error, error);
+  }
+
+  INFO("GPU simulation max position error vs CPU reference: %g", max_error);
+
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct ParticleSystem;
+struct VulkanCommandBuffer;
+struct VulkanCommandPool;
+struct VulkanQueue;
+
+#define SIMULATION_GROUP_SIZE 256
+
+struct PushConstantsSimulation {
+  f32 delta_time;
+  u32 particle_count;
+};
+
+/* keeps the particle state in device-local buffers and integrates it with
+ * particle_update.comp, each frame reads the previous frame's particles and
+ * writes its own. The CPU ParticleSystem is only brought up to date on
+ * demand and serves as the reference */
+struct GpuSimulation {
+  VulkanPipeline pipeline;
+  VulkanBuffer velocities_buffer;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  b8 enabled = false;
+  /* time integrated on the GPU that the CPU reference has not caught up on */
+  f32 pending_time = 0.0f;
+
+  b8 create(VulkanDevice *device);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* uploads the CPU state to every frame, also used to re-seed after the
+   * particle count changed */
+  b8 enable(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            VulkanQueue *queue, VulkanCommandPool *command_pool,
+            ParticleSystem *particle_system,
+            std::vector<FrameResources> &frames);
+  b8 disable(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             ParticleSystem *particle_system,
+             std::vector<FrameResources> &frames);
+
+  /* motion is linear, so the reference catches up in a single step */
+  void syncReference(ParticleSystem *particle_system);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, f32 delta_time);
+
+  /* reads back the particles of last_frame_index and logs the largest
+   * difference to the CPU reference */
+  b8 validate(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+              VulkanQueue *queue, VulkanCommandPool *command_pool,
+              ParticleSystem *particle_system,
+              std::vector<FrameResources> &frames, u32 last_frame_index);
+};
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "light_space.h"
+
+#include <cmath>
+#include <cstring>
+
+glm::mat4 lightOrtho(f32 left, f32 right, f32 bottom, f32 top, f32 z_near,
+                     f32 z_far) {
+  glm::mat4 result = glm::mat4(1.0f);
+  result[0][0] = 2.0f / (right - left);
+  result[1][1] = 2.0f / (top - bottom);
+  result[2][2] = 1.0f / (z_far - z_near);
+  result[3][0] = -(right + left) / (right - left);
+  result[3][1] = -(top + bottom) / (top - bottom);
+  result[3][2] = -z_near / (z_far - z_near);
+
+  return result;
+}
+
+glm::mat4 lightLookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up) {
+  glm::vec3 f = glm::normalize(center - eye);
+  glm::vec3 s = glm::normalize(glm::cross(f, up));
+  glm::vec3 u = glm::cross(s, f);
+
+  glm::mat4 result = glm::mat4(1.0f);
+  result[0][0] = s.x;
+  result[1][0] = s.y;
+  result[2][0] = s.z;
+  result[0][1] = u.x;
+  result[1][1] = u.y;
+  result[2][1] = u.z;
+  result[0][2] = f.x;
+  result[1][2] = f.y;
+  result[2][2] = f.z;
+  result[3][0] = -glm::dot(s, eye);
+  result[3][1] = -glm::dot(u, eye);
+  result[3][2] = -glm::dot(f, eye);
+
+  return result;
+}
+
+glm::mat4 lightMatrix(glm::vec3 sun_dir) {
+  sun_dir = glm::normalize(sun_dir);
+
+  glm::mat4 light_projection =
+      lightOrtho(-1.0f, 1.0f, -1.0f, 1.0f, LIGHT_NEAR, LIGHT_FAR);
+  glm::mat4 light_view = lightLookAt(-sun_dir, glm::vec3(0.0f, 0.0f, 0.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+
+  return light_projection * light_view;
+}
+
+glm::mat4 lightMatrixFitted(glm::vec3 sun_dir, glm::vec3 bounds_min,
+                            glm::vec3 bounds_max, f32 *out_radius_scale) {
+  sun_dir = glm::normalize(sun_dir);
+
+  glm::mat4 light_view = lightLookAt(-sun_dir, glm::vec3(0.0f, 0.0f, 0.0f),
+                                     glm::vec3(0.0f, 1.0f, 0.0f));
+
+  glm::vec3 view_min = glm::vec3(INFINITY);
+  glm::vec3 view_max = glm::vec3(-INFINITY);
+  for (u32 corner = 0; corner < 8; ++corner) {
+    glm::vec3 position = glm::vec3(corner & 1 ? bounds_max.x : bounds_min.x,
+                                   corner & 2 ? bounds_max.y : bounds_min.y,
+                                   corner & 4 ? bounds_max.z : bounds_min.z);
+    glm::vec3 view_position =
+        glm::vec3(light_view * glm::vec4(position, 1.0f));
+    view_min = glm::min(view_min, view_position);
+    view_max = glm::max(view_max, view_position);
+  }
+
+  glm::vec2 center = (glm::vec2(view_min) + glm::vec2(view_max)) * 0.5f;
+  glm::vec2 half_extents = (glm::vec2(view_max) - glm::vec2(view_min)) * 0.5f;
+  f32 half_extent = fmaxf(fmaxf(half_extents.x, half_extents.y), 1e-3f);
+  f32 depth_padding = fmaxf((view_max.z - view_min.z) * 1e-3f, 1e-3f);
+
+  glm::mat4 light_projection = lightOrtho(
+      center.x - half_extent, center.x + half_extent, center.y - half_extent,
+      center.y + half_extent, view_min.z - depth_padding,
+      view_max.z + depth_padding);
+
+  *out_radius_scale = 1.0f / half_extent;
+
+  return light_projection * light_view;
+}
+
+glm::vec2 lightProject(const glm::mat4 &light_matrix, glm::vec3 position) {
+  glm::vec4 projected = light_matrix * glm::vec4(position, 1.0f);
+  return glm::vec2(projected.x, projected.y);
+}
+
+f32 lightDepth(const glm::mat4 &light_matrix, glm::vec3 position) {
+  glm::vec4 projected = light_matrix * glm::vec4(position, 1.0f);
+  return projected.z;
+}
+
+glm::mat4 lightTransform(const LightSource &light) {
+  if (light.vector.w == 0.0f) {
+    return lightMatrix(glm::vec3(light.vector));
+  }
+
+  return lightLookAt(glm::vec3(light.vector), glm::vec3(0.0f, 0.0f, 0.0f),
+                     glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::vec3 lightProjectDisc(const LightSource &light,
+                           const glm::mat4 &transform, glm::vec3 position,
+                           f32 radius) {
+  glm::vec3 transformed = glm::vec3(transform * glm::vec4(position, 1.0f));
+  if (light.vector.w == 0.0f) {
+    return glm::vec3(transformed.x, transformed.y, radius);
+  }
+
+  if (transformed.z <= 0.0f) {
+    return glm::vec3(0.0f, 0.0f, LIGHT_BEHIND_RADIUS);
+  }
+
+  return glm::vec3(transformed.x, transformed.y, radius) / transformed.z;
+}
+
+u32 lightDepthKey(f32 depth) {
+  u32 bits;
+  memcpy(&bits, &depth, sizeof(bits));
+  return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+f32 circleOverlap(glm::vec2 center1, f32 radius1, glm::vec2 center2,
+                  f32 radius2) {
+  f32 distance = glm::distance(center1, center2);
+
+  if (distance >= radius1 + radius2) {
+    return 0.0f;
+  }
+
+  if (distance <= fabsf(radius1 - radius2)) {
+    return 1.0f;
+  }
+
+  f32 d = (radius1 * radius1 - radius2 * radius2 + distance * distance) /
+          (2.0f * distance);
+
+  f32 area1 = acosf(d / radius1) * radius1 * radius1 -
+              d * sqrtf(radius1 * radius1 - d * d);
+  f32 area2 = acosf((distance - d) / radius2) * radius2 * radius2 -
+              (distance - d) *
+                  sqrtf(radius2 * radius2 - (distance - d) * (distance - d));
+
+  return (area1 + area2) /
+         (3.14159265359f * (radius1 * radius1 + radius2 * radius2));
+}
\ No newline at end of file
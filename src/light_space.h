@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core/platform.h"
+
+#include <glm/glm.hpp>
+
+/* C++ mirrors of the helpers in assets/shaders/light_space.glsl, kept
+ * formula-for-formula identical so that CPU results can be compared with the
+ * compute shaders */
+
+#define LIGHT_NEAR -10.0f
+#define LIGHT_FAR 1000.0f
+/* radius of discs behind a point light, never overlaps anything */
+#define LIGHT_BEHIND_RADIUS -3.0e38f
+
+/* vector.w == 0: a directional light shining along vector.xyz like sun_dir,
+ * vector.w == 1: a point light at vector.xyz. Matches Light in
+ * light_space.glsl */
+struct LightSource {
+  glm::vec4 vector;
+  f32 intensity;
+  f32 _pad0;
+  glm::vec2 _pad1;
+};
+
+glm::mat4 lightOrtho(f32 left, f32 right, f32 bottom, f32 top, f32 z_near,
+                     f32 z_far);
+glm::mat4 lightLookAt(glm::vec3 eye, glm::vec3 center, glm::vec3 up);
+glm::mat4 lightMatrix(glm::vec3 sun_dir);
+/* lightMatrix with the ortho bounds fitted around a world-space AABB instead
+ * of [-1, 1]. xy are scaled uniformly so that discs stay circles and keep
+ * their overlap fractions, world radii map into light space by
+ * out_radius_scale */
+glm::mat4 lightMatrixFitted(glm::vec3 sun_dir, glm::vec3 bounds_min,
+                            glm::vec3 bounds_max, f32 *out_radius_scale);
+
+glm::vec2 lightProject(const glm::mat4 &light_matrix, glm::vec3 position);
+/* grows away from the light */
+f32 lightDepth(const glm::mat4 &light_matrix, glm::vec3 position);
+/* lightMatrix for directional lights, a view looking at the origin for point
+ * lights */
+glm::mat4 lightTransform(const LightSource &light);
+/* xy and radius of a particle's disc as seen from the light, transform comes
+ * from lightTransform. Point lights divide by the distance along their view
+ * axis, which keeps the overlap fractions of circleOverlap */
+glm::vec3 lightProjectDisc(const LightSource &light,
+                           const glm::mat4 &transform, glm::vec3 position,
+                           f32 radius);
+/* maps a float to a u32 with the same ordering, used as a radix sort key */
+u32 lightDepthKey(f32 depth);
+
+/* fraction of the two discs' combined area that overlaps */
+f32 circleOverlap(glm::vec2 center1, f32 radius1, glm::vec2 center2,
+                  f32 radius2);
\ No newline at end of file
@@ -1,11 +1,29 @@
 /* clang-format off */
 #include "camera.h"
 #include "geometry.h"
+#include "core/cpu.h"
+#include "core/job_system.h"
 #include "core/file_system.h"
 #include "core/input.h"
 #include "core/logger.h"
 #include "core/platform.h"
+#include "frame_resources.h"
+#include "gpu_simulation.h"
+#include "light_space.h"
+#include "particle_lod.h"
+#include "particle_sort.h"
+#include "particle_weighted_blend.h"
 #include "particle_system.h"
+#include "shadow_amortized.h"
+#include "shadow_binning.h"
+#include "shadow_brute_force.h"
+#include "shadow_depth_sort.h"
+#include "shadow_grid.h"
+#include "shadow_incremental.h"
+#include "shadow_lights.h"
+#include "shadow_opacity_map.h"
+#include "shadow_packed.h"
+#include "shadow_solver.h"
 #ifndef VMA_IMPLEMENTATION
 #define VMA_IMPLEMENTATION
 #endif
@@ -31,27 +49,147 @@
 #include "renderer/vulkan/vulkan_texture.h"
 
 #include <SDL.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <vector>
 #include <vulkan/vulkan.h>
 /* clang-format on */
 
-struct GlobalUBO {
-  glm::mat4 projection;
-  glm::mat4 view;
+#define FRAME_DELTA_TIME 0.005f
+#define SUN_DIRECTION glm::vec4(1.0f, 1.0f, 1.0f, 0.0f)
+/* in seconds, how far a copy of the fresh explosion is advanced to be timed
+ * by the autotuner. The particles then fill a ball of radius
+ * PARTICLE_MAX_SPEED * this, 5 units, and overlap partially */
+#define SHADOW_TUNING_SPREAD_TIME 10.0f
+/* the sun, a dimmer opposite fill and two point lights, see lightsBuild */
+#define SHADOW_LIGHT_COUNT 4
+/* float sums over thousands of occluders do not match bit for bit */
+#define SHADOW_VALIDATION_TOLERANCE 1e-3f
+/* f16 light-space positions and radii are only good to about 1e-3 each */
+#define SHADOW_PACKED_VALIDATION_TOLERANCE 1e-2f
+/* receivers keep shadows computed against occluders up to
+ * SHADOW_INCREMENTAL_EPSILON away from where they are now */
+#define SHADOW_INCREMENTAL_VALIDATION_TOLERANCE 1e-2f
+/* receivers outside the current slice lag by up to a full round of motion */
+#define SHADOW_AMORTIZED_VALIDATION_TOLERANCE 5e-2f
+/* the map samples occluders at the receiver's center, in depth slices and at
+ * texel resolution, instead of overlapping discs in exact order */
+#define SHADOW_OPACITY_MAP_VALIDATION_TOLERANCE 1e-1f
+/* three frequencies blur the absorption over about a third of the depth
+ * range */
+#define SHADOW_FOURIER_VALIDATION_TOLERANCE 1.5e-1f
+
+enum ShadowMode {
+  SHADOW_MODE_BRUTE_FORCE,
+  SHADOW_MODE_BINNED,
+  /* only occluders closer to the light count */
+  SHADOW_MODE_DEPTH_SORTED,
+  /* brute force with subgroup broadcasts where the device supports them */
+  SHADOW_MODE_SUBGROUP,
+  /* brute force over half-precision light-space particles */
+  SHADOW_MODE_PACKED,
+  /* brute force recomputed only around particles that moved */
+  SHADOW_MODE_INCREMENTAL,
+  /* brute force over a round-robin slice of the receivers per frame */
+  SHADOW_MODE_AMORTIZED,
+  /* occluders splatted into a light-space deep opacity map */
+  SHADOW_MODE_OPACITY_MAP,
+  /* the same splat encoding transmittance over depth as Fourier series */
+  SHADOW_MODE_FOURIER,
+  /* brute force against SHADOW_LIGHT_COUNT lights in one dispatch */
+  SHADOW_MODE_LIGHTS,
+  SHADOW_MODE_COUNT,
 };
 
-struct PushConstants {
-  glm::mat4 model;
-  u32 shadow_index;
-  f32 opacity;
+static const char *shadow_mode_names[SHADOW_MODE_COUNT] = {
+    "brute",       "binned",    "sorted",  "subgroup", "packed",
+    "incremental", "amortized", "opacity", "fourier",  "lights"};
+
+enum RenderMode {
+  /* an instanced sphere mesh per particle */
+  RENDER_MODE_MESH,
+  /* a camera-facing quad per particle, ray traced against its sphere */
+  RENDER_MODE_IMPOSTOR,
+  RENDER_MODE_COUNT,
 };
 
-struct PushConstantsCompute {
-  glm::vec4 sun_dir;
+static const char *render_mode_names[RENDER_MODE_COUNT] = {"mesh", "impostor"};
+
+static const char *sort_mode_names[PARTICLE_SORT_MODE_COUNT] = {"none", "gpu",
+                                                                "cpu"};
+
+struct Options {
+  u32 particle_count = DEFAULT_PARTICLE_COUNT;
+  /* 0 picks one worker per hardware thread */
+  u32 worker_count = 0;
+  b8 gpu_simulation = false;
+  ShadowMode shadow_mode = SHADOW_MODE_BRUTE_FORCE;
+  RenderMode render_mode = RENDER_MODE_MESH;
+  /* back to front order of the mesh particles, for blending */
+  ParticleSortMode sort_mode = PARTICLE_SORT_NONE;
+  /* order-independent transparency for the mesh particles, no sort needed */
+  b8 weighted_blend = false;
+  /* > 0 runs that many frames on the CPU solver without a window or device */
+  u32 headless_frames = 0;
+  /* checks the first frames against the CPU reference and exits */
+  b8 self_test = false;
+  /* ignores the cached shadow tuning */
+  b8 retune = false;
+  /* slices of the amortized shadow mode, 0 adapts them to shadow_budget_ms */
+  u32 amortized_slices = 0;
+  f32 shadow_budget_ms = SHADOW_AMORTIZED_DEFAULT_BUDGET_MS;
+  f32 history_blend = 0.0f;
 };
 
+static b8 parseOptions(int argc, char **argv, Options *out_options);
+static b8 runHeadless(Options *options);
+static b8 validateShadows(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator, VulkanQueue *queue,
+                          VulkanCommandPool *command_pool,
+                          FrameResources *frame, u32 particle_count,
+                          glm::vec4 sun_dir, ShadowMode shadow_mode,
+                          f32 *out_error);
+static void lightsBuild(glm::vec4 sun_dir, LightSource *out_lights);
+static void lightUniformUpdate(VulkanMemoryAllocator *allocator,
+                               FrameResources *frame,
+                               ParticleSystem *particle_system,
+                               f32 pending_time, glm::vec4 sun_dir);
+
 int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    FATAL("Usage: %s [--particles <count>] [--workers <count>] "
+          "[--gpu-simulation] "
+          "[--shadow-mode "
+          "brute|binned|sorted|subgroup|packed|incremental|amortized|"
+          "opacity|fourier|lights] "
+          "[--render-mode mesh|impostor] [--sort none|gpu|cpu] "
+          "[--weighted-blend] "
+          "[--amortized-slices <count>] [--shadow-budget <ms>] "
+          "[--history-blend <weight>] [--headless <frames>] [--self-test] "
+          "[--retune]",
+          argv[0]);
+    exit(1);
+  }
+
+  if (!Cpu::initialize()) {
+    FATAL("Failed to query CPU features!");
+    exit(1);
+  }
+
+  if (!JobSystem::initialize(options.worker_count)) {
+    FATAL("Failed to initialize a job system!");
+    exit(1);
+  }
+
+  if (options.headless_frames > 0) {
+    b8 succeeded = runHeadless(&options);
+    JobSystem::shutdown();
+    return succeeded ? 0 : 1;
+  }
+
   if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
     FATAL("Failed to initialize SDL!");
     exit(1);
@@ -167,12 +305,10 @@ int main(int argc, char **argv) {
       &device,
       FileSystem::joinPath("assets/shaders/particle.frag.spv").c_str());
 
-  const u32 sector_count = 36;
-  const u32 stack_count = 18;
-  std::vector<f32> sphere_vertices =
-      generateSphereVertices(1, sector_count, stack_count);
-  std::vector<u32> sphere_indices =
-      generateSphereIndices(sector_count, stack_count);
+  std::vector<f32> sphere_vertices;
+  std::vector<u32> sphere_indices;
+  SphereLod sphere_lods[SPHERE_LOD_COUNT];
+  generateSphereLods(1, &sphere_vertices, &sphere_indices, sphere_lods);
 
   VulkanBuffer sphere_vertex_buffer;
   sphere_vertex_buffer.create(
@@ -191,9 +327,11 @@ int main(int argc, char **argv) {
                                       sphere_indices.data(), &graphics_queue,
                                       &graphics_command_pool);
 
+  /* the impostors project their ray hits in the fragment shader */
   VkDescriptorSetLayoutBinding descriptor_set_layout_binding =
       vulkanDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                       VK_SHADER_STAGE_VERTEX_BIT);
+                                       VK_SHADER_STAGE_VERTEX_BIT |
+                                           VK_SHADER_STAGE_FRAGMENT_BIT);
   VkDescriptorSetLayoutCreateInfo graphics_descriptor_set_layout_create_info =
       {};
   graphics_descriptor_set_layout_create_info.sType =
@@ -204,29 +342,48 @@ int main(int argc, char **argv) {
   graphics_descriptor_set_layout_create_info.pBindings =
       &descriptor_set_layout_binding;
 
-  VkDescriptorSetLayoutBinding writeonly_descriptor_set_layout_binding =
+  /* binding 0: shadow factors, binding 1: per-instance particle data */
+  VkDescriptorSetLayoutBinding writeonly_descriptor_set_layout_bindings[2];
+  writeonly_descriptor_set_layout_bindings[0] =
       vulkanDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                        VK_SHADER_STAGE_FRAGMENT_BIT);
-  writeonly_descriptor_set_layout_binding = vulkanDescriptorSetLayoutBinding(
-      0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+  writeonly_descriptor_set_layout_bindings[1] =
+      vulkanDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                       VK_SHADER_STAGE_VERTEX_BIT);
   VkDescriptorSetLayoutCreateInfo
       graphics_writeonly_descriptor_set_layout_create_info = {};
   graphics_writeonly_descriptor_set_layout_create_info.sType =
       VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   graphics_writeonly_descriptor_set_layout_create_info.pNext = 0;
   graphics_writeonly_descriptor_set_layout_create_info.flags = 0;
-  graphics_writeonly_descriptor_set_layout_create_info.bindingCount = 1;
+  graphics_writeonly_descriptor_set_layout_create_info.bindingCount = 2;
   graphics_writeonly_descriptor_set_layout_create_info.pBindings =
-      &writeonly_descriptor_set_layout_binding;
+      writeonly_descriptor_set_layout_bindings;
+
+  ParticleLod particle_lod;
+  if (!particle_lod.create(&device, &allocator, swapchain.max_frames_in_flight,
+                           sphere_lods)) {
+    FATAL("Failed to create the particle LOD pass!");
+    exit(1);
+  }
 
+  /* set 2 only exists for the mesh pipeline, the impostors skip it */
   std::vector<VkDescriptorSetLayout> graphics_descriptor_set_layouts;
-  graphics_descriptor_set_layouts.resize(2);
+  graphics_descriptor_set_layouts.resize(3);
   graphics_descriptor_set_layouts[0] =
       VulkanDescriptorSetLayoutCache::layoutCreate(
           &device, &graphics_descriptor_set_layout_create_info);
   graphics_descriptor_set_layouts[1] =
       VulkanDescriptorSetLayoutCache::layoutCreate(
           &device, &graphics_writeonly_descriptor_set_layout_create_info);
+  graphics_descriptor_set_layouts[2] =
+      particle_lod.instances_descriptor_set_layout;
+
+  /* base of the LOD's range of the instance list */
+  VkPushConstantRange graphics_push_constant_range = {};
+  graphics_push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  graphics_push_constant_range.offset = 0;
+  graphics_push_constant_range.size = sizeof(u32);
 
   std::vector<VkPipelineShaderStageCreateInfo>
       graphics_pipeline_stage_create_infos;
@@ -249,12 +406,6 @@ int main(int argc, char **argv) {
   graphics_pipeline_stage_create_infos[1].pName = "main";
   graphics_pipeline_stage_create_infos[1].pSpecializationInfo = 0;
 
-  VkPushConstantRange push_constant_range = {};
-  push_constant_range.stageFlags =
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  push_constant_range.offset = 0;
-  push_constant_range.size = sizeof(PushConstants);
-
   VkViewport viewport = {};
   viewport.x = 0.0f;
   viewport.y = window_height;
@@ -273,151 +424,180 @@ int main(int argc, char **argv) {
       &device, &render_pass, graphics_descriptor_set_layouts.size(),
       graphics_descriptor_set_layouts.data(),
       graphics_pipeline_stage_create_infos.size(),
-      graphics_pipeline_stage_create_infos.data(), 1, &push_constant_range, 0,
-      0, viewport, scissor);
+      graphics_pipeline_stage_create_infos.data(), 1,
+      &graphics_push_constant_range, 0, 0, viewport, scissor);
+
+  /* sorted particles blend back to front, depth writes would hide the ones
+   * drawn behind a nearer particle of an earlier LOD */
+  VulkanPipeline sorted_graphics_pipeline;
+  if (!sorted_graphics_pipeline.createGraphics(
+          &device, &render_pass, graphics_descriptor_set_layouts.size(),
+          graphics_descriptor_set_layouts.data(),
+          graphics_pipeline_stage_create_infos.size(),
+          graphics_pipeline_stage_create_infos.data(), 1,
+          &graphics_push_constant_range, 0, 0, viewport, scissor, 0, 0, 1,
+          false, false)) {
+    FATAL("Failed to create the sorted particle pipeline!");
+    exit(1);
+  }
+
+  ParticleWeightedBlend particle_weighted_blend;
+  if (!particle_weighted_blend.create(
+          &device, &allocator, &swapchain, window_width, window_height,
+          graphics_descriptor_set_layouts.size(),
+          graphics_descriptor_set_layouts.data(),
+          &graphics_push_constant_range, viewport, scissor)) {
+    FATAL("Failed to create the weighted blend pass!");
+    exit(1);
+  }
 
   vertex_shader_module.destroy(&device);
   fragment_shader_module.destroy(&device);
 
-  VulkanBuffer global_uniform_buffer;
-  global_uniform_buffer.create(&allocator, sizeof(GlobalUBO),
-                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                               VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-  VulkanBuffer shadows_buffer;
-  shadows_buffer.create(&allocator, sizeof(f32) * NUM_PARTICLES,
-                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                        VMA_MEMORY_USAGE_GPU_ONLY);
-
-  VulkanDescriptorSetBuilder builder;
-  VkDescriptorSet global_ubo_descriptor_set;
-  builder.begin();
-  VkDescriptorBufferInfo global_ubo_buffer_info = {};
-  global_ubo_buffer_info.buffer = global_uniform_buffer.handle;
-  global_ubo_buffer_info.offset = 0;
-  global_ubo_buffer_info.range = global_uniform_buffer.size;
-  builder.bufferBind(0, &global_ubo_buffer_info,
-                     VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                     VK_SHADER_STAGE_VERTEX_BIT);
-  builder.end(&device, &global_ubo_descriptor_set);
-
-  builder = {};
-  VkDescriptorSet graphics_readonly_descriptor_set;
-  VkDescriptorBufferInfo graphics_readonly_buffer_info = {};
-  graphics_readonly_buffer_info.buffer = shadows_buffer.handle;
-  graphics_readonly_buffer_info.offset = 0;
-  graphics_readonly_buffer_info.range = shadows_buffer.size;
-  builder.bufferBind(0, &graphics_readonly_buffer_info,
-                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                     VK_SHADER_STAGE_FRAGMENT_BIT);
-  builder.end(&device, &graphics_readonly_descriptor_set);
-
-  VulkanShaderModule compute_shader_module;
-  compute_shader_module.create(
-      &device,
-      FileSystem::joinPath("assets/shaders/particle_shadowing.comp.spv")
-          .c_str());
-
-  VkPipelineShaderStageCreateInfo compute_stage_create_info = {};
-  compute_stage_create_info.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  compute_stage_create_info.pNext = 0;
-  compute_stage_create_info.flags = 0;
-  compute_stage_create_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-  compute_stage_create_info.module = compute_shader_module.handle;
-  compute_stage_create_info.pName = "main";
-  compute_stage_create_info.pSpecializationInfo = 0;
-
-  descriptor_set_layout_binding = vulkanDescriptorSetLayoutBinding(
-      0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
-  VkDescriptorSetLayoutCreateInfo
-      compute_readonly_descriptor_set_layout_create_info = {};
-  compute_readonly_descriptor_set_layout_create_info.sType =
-      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  compute_readonly_descriptor_set_layout_create_info.pNext = 0;
-  compute_readonly_descriptor_set_layout_create_info.flags = 0;
-  compute_readonly_descriptor_set_layout_create_info.bindingCount = 1;
-  compute_readonly_descriptor_set_layout_create_info.pBindings =
-      &descriptor_set_layout_binding;
+  VulkanShaderModule impostor_vertex_shader_module;
+  VulkanShaderModule impostor_fragment_shader_module;
+  if (!impostor_vertex_shader_module.create(
+          &device, FileSystem::joinPath(
+                       "assets/shaders/particle_impostor.vert.spv")
+                       .c_str()) ||
+      !impostor_fragment_shader_module.create(
+          &device, FileSystem::joinPath(
+                       "assets/shaders/particle_impostor.frag.spv")
+                       .c_str())) {
+    FATAL("Failed to load the impostor shaders!");
+    exit(1);
+  }
 
-  descriptor_set_layout_binding = vulkanDescriptorSetLayoutBinding(
-      0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
-  VkDescriptorSetLayoutCreateInfo
-      compute_writeonly_descriptor_set_layout_create_info = {};
-  compute_writeonly_descriptor_set_layout_create_info.sType =
-      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  compute_writeonly_descriptor_set_layout_create_info.pNext = 0;
-  compute_writeonly_descriptor_set_layout_create_info.flags = 0;
-  compute_writeonly_descriptor_set_layout_create_info.bindingCount = 1;
-  compute_writeonly_descriptor_set_layout_create_info.pBindings =
-      &descriptor_set_layout_binding;
+  VkPipelineShaderStageCreateInfo impostor_stage_infos[2] = {
+      vulkanPipelineShaderStageCreateInfo(&impostor_vertex_shader_module,
+                                          VK_SHADER_STAGE_VERTEX_BIT),
+      vulkanPipelineShaderStageCreateInfo(&impostor_fragment_shader_module,
+                                          VK_SHADER_STAGE_FRAGMENT_BIT)};
+
+  /* sets 0 and 1 match the mesh pipeline, so the frame's descriptor sets
+   * bind to either */
+  VulkanPipeline impostor_pipeline;
+  if (!impostor_pipeline.createGraphics(
+          &device, &render_pass, 2, graphics_descriptor_set_layouts.data(), 2,
+          impostor_stage_infos, 0, 0, 0, 0, viewport, scissor, 0, 0, 1,
+          true)) {
+    FATAL("Failed to create the impostor pipeline!");
+    exit(1);
+  }
 
-  std::vector<VkDescriptorSetLayout> compute_descriptor_set_layouts;
-  compute_descriptor_set_layouts.resize(2);
-  compute_descriptor_set_layouts[0] =
-      VulkanDescriptorSetLayoutCache::layoutCreate(
-          &device, &compute_readonly_descriptor_set_layout_create_info);
-  compute_descriptor_set_layouts[1] =
-      VulkanDescriptorSetLayoutCache::layoutCreate(
-          &device, &compute_writeonly_descriptor_set_layout_create_info);
-
-  VkPushConstantRange compute_push_constant_range = {};
-  compute_push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-  compute_push_constant_range.offset = 0;
-  compute_push_constant_range.size = sizeof(PushConstantsCompute);
-
-  VulkanPipeline compute_pipeline;
-  compute_pipeline.createCompute(&device, compute_descriptor_set_layouts.size(),
-                                 compute_descriptor_set_layouts.data(), 1,
-                                 &compute_push_constant_range,
-                                 compute_stage_create_info);
-
-  compute_shader_module.destroy(&device);
-
-  VulkanBuffer compute_readonly_buffer;
-  compute_readonly_buffer.create(&allocator, sizeof(Particle) * NUM_PARTICLES,
-                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                 VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-  builder = {};
-  VkDescriptorSet compute_readonly_descriptor_set;
-  builder.begin();
-  VkDescriptorBufferInfo compute_readonly_buffer_info = {};
-  compute_readonly_buffer_info.buffer = compute_readonly_buffer.handle;
-  compute_readonly_buffer_info.offset = 0;
-  compute_readonly_buffer_info.range = compute_readonly_buffer.size;
-  builder.bufferBind(0, &compute_readonly_buffer_info,
-                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                     VK_SHADER_STAGE_COMPUTE_BIT);
-  builder.end(&device, &compute_readonly_descriptor_set);
-
-  builder = {};
-  VkDescriptorSet compute_writeonly_descriptor_set;
-  builder.begin();
-  VkDescriptorBufferInfo compute_writeonly_buffer_info = {};
-  compute_writeonly_buffer_info.buffer = shadows_buffer.handle;
-  compute_writeonly_buffer_info.offset = 0;
-  compute_writeonly_buffer_info.range = shadows_buffer.size;
-  builder.bufferBind(0, &compute_writeonly_buffer_info,
-                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                     VK_SHADER_STAGE_COMPUTE_BIT);
-  builder.end(&device, &compute_writeonly_descriptor_set);
+  impostor_vertex_shader_module.destroy(&device);
+  impostor_fragment_shader_module.destroy(&device);
 
   Camera camera;
   camera.create(45, (f32)window_width / (f32)window_height, 0.1f, 1000.0f);
 
   ParticleSystem particle_system;
-  particle_system.createExplosion(glm::vec3(0.0f));
+  particle_system.create(options.particle_count);
+
+  std::vector<FrameResources> frames;
+  frames.resize(swapchain.max_frames_in_flight);
+  for (u32 i = 0; i < frames.size(); ++i) {
+    frames[i].create(&device, &allocator, particle_system.count);
+  }
+
+  ShadowBruteForce shadow_brute_force;
+  if (!shadow_brute_force.create(&device)) {
+    FATAL("Failed to create a shadowing pipeline!");
+    exit(1);
+  }
+  if (!shadow_brute_force.tuned || options.retune) {
+    /* runs before the GPU simulation can take the particles off the host.
+     * A fresh explosion has every particle at the origin, where every pair
+     * takes circleOverlap's containment early-out and the timings, cached
+     * for every later run, would not reflect the real branches and
+     * transcendentals. A spread out copy is timed instead */
+    ParticleSystem tuning_system = particle_system;
+    tuning_system.update(SHADOW_TUNING_SPREAD_TIME);
+    std::vector<Particle> particles(tuning_system.count);
+    tuning_system.pack(particles.data(), 0, tuning_system.count);
+    lightUniformUpdate(&allocator, &frames[0], &tuning_system, 0.0f,
+                       SUN_DIRECTION);
+    if (!shadow_brute_force.autotune(&device, &allocator, &compute_queue,
+                                     &compute_command_pool, &frames[0],
+                                     particles.data(), tuning_system.count,
+                                     SUN_DIRECTION)) {
+      FATAL("Failed to tune the shadowing pipeline!");
+      exit(1);
+    }
+  }
+
+  GpuSimulation gpu_simulation;
+  if (!gpu_simulation.create(&device)) {
+    FATAL("Failed to create a GPU simulation!");
+    exit(1);
+  }
+  if (options.gpu_simulation &&
+      !gpu_simulation.enable(&device, &allocator, &graphics_queue,
+                             &graphics_command_pool, &particle_system,
+                             frames)) {
+    FATAL("Failed to enable the GPU simulation!");
+    exit(1);
+  }
+
+  ShadowBinning shadow_binning;
+  if (!shadow_binning.create(&device, &allocator, frames.size())) {
+    FATAL("Failed to create shadow binning!");
+    exit(1);
+  }
+  ShadowDepthSort shadow_depth_sort;
+  if (!shadow_depth_sort.create(&device, frames.size())) {
+    FATAL("Failed to create shadow depth sort!");
+    exit(1);
+  }
+  ParticleSort particle_sort;
+  if (!particle_sort.create(&device, frames.size())) {
+    FATAL("Failed to create the particle sort!");
+    exit(1);
+  }
+  ShadowPacked shadow_packed;
+  if (!shadow_packed.create(&device, frames.size(),
+                            shadow_brute_force.tuning)) {
+    FATAL("Failed to create packed shadowing!");
+    exit(1);
+  }
+  ShadowIncremental shadow_incremental;
+  if (!shadow_incremental.create(&device, &allocator, frames.size())) {
+    FATAL("Failed to create incremental shadowing!");
+    exit(1);
+  }
+  ShadowAmortized shadow_amortized;
+  if (!shadow_amortized.create(&device, frames.size(),
+                               options.amortized_slices,
+                               options.shadow_budget_ms,
+                               options.history_blend)) {
+    FATAL("Failed to create amortized shadowing!");
+    exit(1);
+  }
+  ShadowLights shadow_lights;
+  if (!shadow_lights.create(&device, &allocator, frames.size())) {
+    FATAL("Failed to create multi-light shadowing!");
+    exit(1);
+  }
+  ShadowOpacityMap shadow_opacity_map;
+  if (!shadow_opacity_map.create(&device, &allocator, frames.size())) {
+    FATAL("Failed to create the shadow opacity map!");
+    exit(1);
+  }
+  ShadowMode shadow_mode = options.shadow_mode;
+  RenderMode render_mode = options.render_mode;
+  ParticleSortMode sort_mode = options.sort_mode;
+  b8 weighted_blend = options.weighted_blend;
+
+  glm::vec4 sun_dir = SUN_DIRECTION;
 
   glm::ivec2 previous_mouse = {0, 0};
   b8 running = true;
   uint32_t current_frame = 0;
+  /* particle count and mode of the last submitted shadow pass */
+  u32 shadow_count = particle_system.count;
+  ShadowMode submitted_shadow_mode = shadow_mode;
+  u32 frame_number = 0;
+  int exit_code = 0;
   while (running) {
     SDL_Event event;
     Input::begin();
@@ -452,7 +632,7 @@ int main(int argc, char **argv) {
       }
     }
 
-    float delta_time = 0.005f;
+    float delta_time = FRAME_DELTA_TIME;
     glm::ivec2 current_mouse;
     Input::getMousePosition(&current_mouse.x, &current_mouse.y);
     glm::vec2 mouse_delta = current_mouse - previous_mouse;
@@ -471,34 +651,223 @@ int main(int argc, char **argv) {
       camera.zoom(delta_time * wheel_movement.y * 5);
     }
 
-    particle_system.update(delta_time);
+    u32 particle_count = particle_system.count;
+    if (Input::wasKeyPressed(SDLK_EQUALS) &&
+        particle_system.count <= PARTICLE_MAX_COUNT / 2) {
+      particle_count = particle_system.count * 2;
+    }
+    if (Input::wasKeyPressed(SDLK_MINUS) && particle_system.count > 1) {
+      particle_count = particle_system.count / 2;
+    }
+    if (particle_count != particle_system.count) {
+      /* the reference has to be current before particles are added, the GPU
+       * state is then re-seeded from it */
+      gpu_simulation.syncReference(&particle_system);
+      particle_system.resize(particle_count, glm::vec3(0.0f));
+      particle_sort.invalidate();
+      if (gpu_simulation.enabled &&
+          !gpu_simulation.enable(&device, &allocator, &graphics_queue,
+                                 &graphics_command_pool, &particle_system,
+                                 frames)) {
+        FATAL("Failed to re-seed the GPU simulation!");
+        exit(1);
+      }
+      INFO("Particle count: %u", particle_system.count);
+    }
+
+    if (Input::wasKeyPressed(SDLK_g)) {
+      b8 toggled =
+          gpu_simulation.enabled
+              ? gpu_simulation.disable(&device, &allocator, &particle_system,
+                                       frames)
+              : gpu_simulation.enable(&device, &allocator, &graphics_queue,
+                                      &graphics_command_pool,
+                                      &particle_system, frames);
+      if (!toggled) {
+        FATAL("Failed to switch the simulation mode!");
+        exit(1);
+      }
+      INFO("Simulation: %s", gpu_simulation.enabled ? "GPU" : "CPU");
+    }
+    if (Input::wasKeyPressed(SDLK_v)) {
+      gpu_simulation.validate(
+          &device, &allocator, &graphics_queue, &graphics_command_pool,
+          &particle_system, frames,
+          (current_frame + frames.size() - 1) % frames.size());
+    }
+    if (Input::wasKeyPressed(SDLK_b)) {
+      shadow_mode = (ShadowMode)((shadow_mode + 1) % SHADOW_MODE_COUNT);
+      INFO("Shadow mode: %s", shadow_mode_names[shadow_mode]);
+      /* the other modes do not keep its cache up to date */
+      shadow_incremental.invalidate();
+      shadow_amortized.invalidate();
+    }
+    if (Input::wasKeyPressed(SDLK_i)) {
+      render_mode = (RenderMode)((render_mode + 1) % RENDER_MODE_COUNT);
+      INFO("Render mode: %s", render_mode_names[render_mode]);
+    }
+    if (Input::wasKeyPressed(SDLK_s)) {
+      sort_mode =
+          (ParticleSortMode)((sort_mode + 1) % PARTICLE_SORT_MODE_COUNT);
+      INFO("Sort mode: %s", sort_mode_names[sort_mode]);
+    }
+    if (Input::wasKeyPressed(SDLK_o)) {
+      weighted_blend = !weighted_blend;
+      INFO("Weighted blend: %s", weighted_blend ? "on" : "off");
+    }
+    /* once every frame in flight has been submitted at least once */
+    b8 self_test_frame =
+        options.self_test && frame_number == swapchain.max_frames_in_flight;
+    if (Input::wasKeyPressed(SDLK_c) || self_test_frame) {
+      /* the particle count and mode may have changed this frame, the last
+       * submitted frame still holds the old ones */
+      f32 error = 0.0f;
+      b8 validated = validateShadows(
+          &device, &allocator, &graphics_queue, &graphics_command_pool,
+          &frames[(current_frame + frames.size() - 1) % frames.size()],
+          shadow_count, sun_dir, submitted_shadow_mode, &error);
+
+      if (self_test_frame) {
+        f32 tolerance = SHADOW_VALIDATION_TOLERANCE;
+        if (submitted_shadow_mode == SHADOW_MODE_PACKED &&
+            shadow_packed.half_precision) {
+          tolerance = SHADOW_PACKED_VALIDATION_TOLERANCE;
+        } else if (submitted_shadow_mode == SHADOW_MODE_INCREMENTAL) {
+          tolerance = SHADOW_INCREMENTAL_VALIDATION_TOLERANCE;
+        } else if (submitted_shadow_mode == SHADOW_MODE_AMORTIZED) {
+          tolerance = SHADOW_AMORTIZED_VALIDATION_TOLERANCE;
+        } else if (submitted_shadow_mode == SHADOW_MODE_OPACITY_MAP) {
+          tolerance = SHADOW_OPACITY_MAP_VALIDATION_TOLERANCE;
+        } else if (submitted_shadow_mode == SHADOW_MODE_FOURIER) {
+          tolerance = SHADOW_FOURIER_VALIDATION_TOLERANCE;
+        }
+        b8 passed = validated && error <= tolerance;
+        INFO("Self test %s: %s shadows, %u particles, error %g (tolerance %g)",
+             passed ? "passed" : "failed",
+             shadow_mode_names[submitted_shadow_mode], shadow_count, error,
+             tolerance);
+        exit_code = passed ? 0 : 1;
+        break;
+      }
+    }
 
-    device.waitIdle();
+    /* runs while the GPU is still busy with the previous frames */
+    if (!gpu_simulation.enabled) {
+      particle_system.update(delta_time);
+    }
 
+    /* only this frame's resources have to be free, the other frames in
+     * flight keep going */
     VulkanFence &compute_fence = compute_in_flight_fences[current_frame];
+    VulkanFence &graphics_fence = in_flight_fences[current_frame];
     compute_fence.wait(&device, UINT64_MAX);
+    graphics_fence.wait(&device, UINT64_MAX);
     compute_fence.reset(&device);
 
+    FrameResources &frame = frames[current_frame];
+    if (!frame.reserve(&device, &allocator, particle_system.count)) {
+      FATAL("Failed to grow particle buffers!");
+      exit(1);
+    }
+
     VulkanCommandBuffer &compute_command_buffer =
         compute_command_buffers[current_frame];
     compute_command_buffer.begin(0);
 
-    compute_command_buffer.pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE,
-                                        &compute_pipeline);
-    compute_readonly_buffer.loadData(&allocator, particle_system.particles);
-    compute_command_buffer.descriptorSetBind(
-        &compute_pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
-        compute_readonly_descriptor_set, 0, 0, 0);
-    compute_command_buffer.descriptorSetBind(
-        &compute_pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
-        compute_writeonly_descriptor_set, 1, 0, 0);
-    PushConstantsCompute push_constants_compute;
-    push_constants_compute.sun_dir = glm::vec4(1.0f, 1.0f, 1.0f, 0.0);
-    compute_command_buffer.pushConstants(
-        &compute_pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-        sizeof(PushConstantsCompute), &push_constants_compute);
-
-    compute_command_buffer.dispatch(NUM_PARTICLES / 256, 1);
+    if (gpu_simulation.enabled) {
+      gpu_simulation.record(&compute_command_buffer, current_frame,
+                            particle_system.count, delta_time);
+    } else {
+      /* packed straight into the persistently mapped upload buffer, only the
+       * live range is written and flushed */
+      particle_system.pack((Particle *)frame.particles_buffer.mapped, 0,
+                           particle_system.count);
+      frame.particles_buffer.flush(&allocator, 0,
+                                   sizeof(Particle) * particle_system.count);
+    }
+
+    lightUniformUpdate(&allocator, &frame, &particle_system,
+                       gpu_simulation.enabled ? gpu_simulation.pending_time
+                                              : 0.0f,
+                       sun_dir);
+
+    /* both encodings splat in a render pass, so they are recorded into the
+     * graphics command buffer */
+    b8 opacity_map_mode = shadow_mode == SHADOW_MODE_OPACITY_MAP ||
+                          shadow_mode == SHADOW_MODE_FOURIER;
+
+    if (shadow_mode == SHADOW_MODE_BINNED) {
+      if (!shadow_binning.prepare(&device, &allocator, frames, current_frame,
+                                  particle_system.count)) {
+        FATAL("Failed to prepare shadow binning!");
+        exit(1);
+      }
+
+      shadow_binning.record(&compute_command_buffer, current_frame,
+                            particle_system.count, sun_dir);
+    } else if (shadow_mode == SHADOW_MODE_DEPTH_SORTED) {
+      if (!shadow_depth_sort.prepare(&device, &allocator, frames,
+                                     current_frame, particle_system.count)) {
+        FATAL("Failed to prepare shadow depth sort!");
+        exit(1);
+      }
+
+      shadow_depth_sort.record(&compute_command_buffer, current_frame,
+                               particle_system.count, sun_dir);
+    } else if (shadow_mode == SHADOW_MODE_AMORTIZED) {
+      if (!shadow_amortized.prepare(&device, &allocator, current_frame,
+                                    particle_system.count)) {
+        FATAL("Failed to prepare amortized shadowing!");
+        exit(1);
+      }
+
+      shadow_amortized.record(&compute_command_buffer, &shadow_brute_force,
+                              &frame, current_frame, particle_system.count,
+                              sun_dir);
+    } else if (shadow_mode == SHADOW_MODE_INCREMENTAL) {
+      if (!shadow_incremental.prepare(&device, &allocator, frames,
+                                      current_frame, particle_system.count)) {
+        FATAL("Failed to prepare incremental shadowing!");
+        exit(1);
+      }
+
+      shadow_incremental.record(&compute_command_buffer, current_frame,
+                                particle_system.count, sun_dir);
+    } else if (shadow_mode == SHADOW_MODE_PACKED) {
+      if (!shadow_packed.prepare(&device, &allocator, frames, current_frame,
+                                 particle_system.count)) {
+        FATAL("Failed to prepare packed shadowing!");
+        exit(1);
+      }
+
+      shadow_packed.record(&compute_command_buffer, current_frame,
+                           particle_system.count, sun_dir);
+    } else if (shadow_mode == SHADOW_MODE_LIGHTS) {
+      LightSource lights[SHADOW_LIGHT_COUNT];
+      lightsBuild(sun_dir, lights);
+      if (!shadow_lights.prepare(&device, &allocator, frames, current_frame,
+                                 particle_system.count, lights,
+                                 SHADOW_LIGHT_COUNT)) {
+        FATAL("Failed to prepare multi-light shadowing!");
+        exit(1);
+      }
+
+      shadow_lights.record(&compute_command_buffer, current_frame,
+                           particle_system.count);
+    } else if (opacity_map_mode) {
+      if (!shadow_opacity_map.prepare(&device, frames, current_frame)) {
+        FATAL("Failed to prepare the shadow opacity map!");
+        exit(1);
+      }
+    } else if (shadow_mode == SHADOW_MODE_SUBGROUP) {
+      shadow_brute_force.recordSubgroup(&compute_command_buffer, &frame,
+                                        particle_system.count, sun_dir);
+    } else {
+      shadow_brute_force.record(&compute_command_buffer, &frame,
+                                particle_system.count, sun_dir);
+    }
+    shadow_count = particle_system.count;
+    submitted_shadow_mode = shadow_mode;
 
     compute_command_buffer.end();
 
@@ -506,9 +875,6 @@ int main(int argc, char **argv) {
                          &compute_finished_semaphores[current_frame],
                          &compute_fence, 0);
 
-    VulkanFence &graphics_fence = in_flight_fences[current_frame];
-    compute_fence.wait(&device, UINT64_MAX);
-    graphics_fence.wait(&device, UINT64_MAX);
     graphics_fence.reset(&device);
 
     VulkanSemaphore &image_available_semaphore =
@@ -522,12 +888,69 @@ int main(int argc, char **argv) {
         graphics_command_buffers[current_frame];
     graphics_command_buffer.begin(0);
 
+    if (opacity_map_mode) {
+      shadow_opacity_map.record(&graphics_command_buffer, current_frame,
+                                particle_system.count, sun_dir,
+                                shadow_mode == SHADOW_MODE_FOURIER
+                                    ? OPACITY_MAP_ENCODING_FOURIER
+                                    : OPACITY_MAP_ENCODING_SLICES);
+    }
+
+    GlobalUBO global_ubo;
+    global_ubo.projection = camera.getProjectionMatrix();
+    global_ubo.view = camera.getViewMatrix();
+    frame.global_uniform_buffer.loadData(&allocator, &global_ubo);
+
+    /* the host copy lags behind a GPU simulation, it only seeds the GPU
+     * sort there */
+    ParticleSortMode frame_sort_mode =
+        sort_mode == PARTICLE_SORT_CPU && gpu_simulation.enabled
+            ? PARTICLE_SORT_GPU
+            : sort_mode;
+    /* weighted blending does not depend on the order, it replaces the sort */
+    b8 weighted = render_mode == RENDER_MODE_MESH && weighted_blend;
+    b8 sorted = render_mode == RENDER_MODE_MESH && !weighted &&
+                frame_sort_mode != PARTICLE_SORT_NONE;
+    if (sorted) {
+      if (!particle_sort.prepare(&device, &allocator, frames, current_frame,
+                                 &particle_system, camera.position,
+                                 frame_sort_mode)) {
+        FATAL("Failed to prepare the particle sort!");
+        exit(1);
+      }
+
+      particle_sort.record(&graphics_command_buffer, current_frame,
+                           particle_system.count, camera.position);
+    }
+
+    if (render_mode == RENDER_MODE_MESH) {
+      if (!particle_lod.prepare(&device, &allocator, frames, current_frame,
+                                particle_system.count,
+                                sorted ? &particle_sort : 0)) {
+        FATAL("Failed to prepare the particle LODs!");
+        exit(1);
+      }
+
+      glm::vec4 frustum_planes[6];
+      camera.getFrustumPlanes(frustum_planes);
+      particle_lod.record(&graphics_command_buffer, current_frame,
+                          particle_system.count, frustum_planes,
+                          camera.position,
+                          global_ubo.projection[1][1] * window_height * 0.5f,
+                          sorted);
+    }
+
     VulkanFramebuffer &framebuffer = framebuffers[image_index];
 
     glm::vec4 clear_color = {1, 0, 0, 1};
     glm::vec4 render_area = {0, 0, window_width, window_height};
-    graphics_command_buffer.renderPassBegin(&render_pass, &framebuffer,
-                                            clear_color, render_area);
+    if (weighted) {
+      particle_weighted_blend.begin(&graphics_command_buffer, image_index,
+                                    clear_color, render_area);
+    } else {
+      graphics_command_buffer.renderPassBegin(&render_pass, &framebuffer,
+                                              clear_color, render_area);
+    }
 
     glm::vec4 viewport_values = {0.0f, render_area.w, render_area.z,
                                  -render_area.w};
@@ -535,42 +958,46 @@ int main(int argc, char **argv) {
     glm::vec4 scissor_values = {0, 0, render_area.z, render_area.w};
     graphics_command_buffer.scissorSet(scissor_values);
 
-    GlobalUBO global_ubo;
-    global_ubo.projection = camera.getProjectionMatrix();
-    global_ubo.view = camera.getViewMatrix();
-    global_uniform_buffer.loadData(&allocator, &global_ubo);
-
+    VulkanPipeline *particle_pipeline = &graphics_pipeline;
+    if (render_mode == RENDER_MODE_IMPOSTOR) {
+      particle_pipeline = &impostor_pipeline;
+    } else if (weighted) {
+      particle_pipeline = &particle_weighted_blend.pipeline;
+    } else if (sorted) {
+      particle_pipeline = &sorted_graphics_pipeline;
+    }
     graphics_command_buffer.pipelineBind(VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                         &graphics_pipeline);
-    graphics_command_buffer.bufferVertexBind(&sphere_vertex_buffer, 0);
-    graphics_command_buffer.bufferIndexBind(&sphere_index_buffer, 0);
+                                         particle_pipeline);
+    graphics_command_buffer.descriptorSetBind(
+        particle_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        frame.global_ubo_descriptor_set, 0, 0, 0);
     graphics_command_buffer.descriptorSetBind(
-        &graphics_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        global_ubo_descriptor_set, 0, 0, 0);
-    for (u32 i = 0; i < NUM_PARTICLES; ++i) {
-      PushConstants push_constants;
-      push_constants.model =
-          glm::translate(glm::mat4(1.0f), particle_system.particles[i].pos) *
-          glm::scale(glm::mat4(1.0f),
-                     glm::vec3(particle_system.particles[i].radius));
-      push_constants.shadow_index = i;
-      push_constants.opacity = particle_system.particles[i].opacity;
-      graphics_command_buffer.pushConstants(
-          &graphics_pipeline,
-          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-          sizeof(PushConstants), &push_constants);
-      graphics_command_buffer.descriptorSetBind(
-          &graphics_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS,
-          graphics_readonly_descriptor_set, 1, 0, 0);
-      graphics_command_buffer.drawIndexed(sphere_indices.size());
+        particle_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        frame.graphics_descriptor_set, 1, 0, 0);
+    if (render_mode == RENDER_MODE_IMPOSTOR) {
+      /* two triangles per instance, pulled from the particle buffer */
+      graphics_command_buffer.draw(6, particle_system.count);
+    } else {
+      graphics_command_buffer.bufferVertexBind(&sphere_vertex_buffer, 0);
+      graphics_command_buffer.bufferIndexBind(&sphere_index_buffer, 0);
+      particle_lod.draw(&graphics_command_buffer, particle_pipeline,
+                        current_frame, sorted);
     }
 
-    graphics_command_buffer.renderPassEnd();
+    if (weighted) {
+      particle_weighted_blend.end(&graphics_command_buffer);
+    } else {
+      graphics_command_buffer.renderPassEnd();
+    }
 
     graphics_command_buffer.end();
 
+    /* the opacity map and LOD passes read the simulated particles before any
+     * vertex input */
     VkPipelineStageFlags wait_dst_stage_masks[2] = {
-        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        opacity_map_mode || render_mode == RENDER_MODE_MESH
+            ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+            : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     std::vector<VulkanSemaphore> wait_semaphores = {
         compute_finished_semaphores[current_frame],
@@ -584,21 +1011,35 @@ int main(int argc, char **argv) {
         &swapchain, &render_finished_semaphores[current_frame], image_index);
 
     current_frame = (current_frame + 1) % swapchain.max_frames_in_flight;
+    frame_number++;
 
     Input::getMousePosition(&previous_mouse.x, &previous_mouse.y);
   }
 
   device.waitIdle();
 
-  shadows_buffer.destroy(&allocator);
-  compute_readonly_buffer.destroy(&allocator);
+  for (u32 i = 0; i < frames.size(); ++i) {
+    frames[i].destroy(&allocator);
+  }
 
   sphere_vertex_buffer.destroy(&allocator);
   sphere_index_buffer.destroy(&allocator);
 
-  compute_pipeline.destroy(&device);
-
-  global_uniform_buffer.destroy(&allocator);
+  shadow_brute_force.destroy(&device);
+  gpu_simulation.destroy(&device, &allocator);
+  shadow_binning.destroy(&device, &allocator);
+  shadow_amortized.destroy(&device, &allocator);
+  shadow_opacity_map.destroy(&device, &allocator);
+  shadow_lights.destroy(&device, &allocator);
+  shadow_incremental.destroy(&device, &allocator);
+  shadow_packed.destroy(&device, &allocator);
+  shadow_depth_sort.destroy(&device, &allocator);
+  particle_sort.destroy(&device, &allocator);
+  particle_lod.destroy(&device, &allocator);
+
+  particle_weighted_blend.destroy(&device, &allocator);
+  impostor_pipeline.destroy(&device);
+  sorted_graphics_pipeline.destroy(&device);
   graphics_pipeline.destroy(&device);
 
   VulkanDescriptorSetLayoutCache::shutdown(&device);
@@ -645,5 +1086,270 @@ int main(int argc, char **argv) {
   SDL_DestroyWindow(window);
   SDL_Quit();
 
-  return 0;
+  JobSystem::shutdown();
+
+  return exit_code;
+}
+
+static b8 parseOptions(int argc, char **argv, Options *out_options) {
+  for (i32 i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--particles") && i + 1 < argc) {
+      i64 particle_count = strtol(argv[++i], 0, 10);
+      if (particle_count <= 0 || particle_count > PARTICLE_MAX_COUNT) {
+        ERROR("Invalid particle count: '%s', expected 1 to %u", argv[i],
+              PARTICLE_MAX_COUNT);
+        return false;
+      }
+
+      out_options->particle_count = particle_count;
+    } else if (!strcmp(argv[i], "--workers") && i + 1 < argc) {
+      i64 worker_count = strtol(argv[++i], 0, 10);
+      if (worker_count < 0) {
+        ERROR("Invalid worker count: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->worker_count = worker_count;
+    } else if (!strcmp(argv[i], "--gpu-simulation")) {
+      out_options->gpu_simulation = true;
+    } else if (!strcmp(argv[i], "--weighted-blend")) {
+      out_options->weighted_blend = true;
+    } else if (!strcmp(argv[i], "--shadow-mode") && i + 1 < argc) {
+      ++i;
+      u32 mode = 0;
+      while (mode < SHADOW_MODE_COUNT &&
+             strcmp(argv[i], shadow_mode_names[mode])) {
+        ++mode;
+      }
+      if (mode == SHADOW_MODE_COUNT) {
+        ERROR("Unknown shadow mode: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->shadow_mode = (ShadowMode)mode;
+    } else if (!strcmp(argv[i], "--render-mode") && i + 1 < argc) {
+      ++i;
+      u32 mode = 0;
+      while (mode < RENDER_MODE_COUNT &&
+             strcmp(argv[i], render_mode_names[mode])) {
+        ++mode;
+      }
+      if (mode == RENDER_MODE_COUNT) {
+        ERROR("Unknown render mode: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->render_mode = (RenderMode)mode;
+    } else if (!strcmp(argv[i], "--sort") && i + 1 < argc) {
+      ++i;
+      u32 mode = 0;
+      while (mode < PARTICLE_SORT_MODE_COUNT &&
+             strcmp(argv[i], sort_mode_names[mode])) {
+        ++mode;
+      }
+      if (mode == PARTICLE_SORT_MODE_COUNT) {
+        ERROR("Unknown sort mode: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->sort_mode = (ParticleSortMode)mode;
+    } else if (!strcmp(argv[i], "--amortized-slices") && i + 1 < argc) {
+      i64 slices = strtol(argv[++i], 0, 10);
+      if (slices < 0 || slices > SHADOW_AMORTIZED_MAX_SLICES) {
+        ERROR("Invalid slice count: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->amortized_slices = slices;
+    } else if (!strcmp(argv[i], "--shadow-budget") && i + 1 < argc) {
+      f32 budget_ms = strtof(argv[++i], 0);
+      if (budget_ms <= 0.0f) {
+        ERROR("Invalid shadow budget: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->shadow_budget_ms = budget_ms;
+    } else if (!strcmp(argv[i], "--history-blend") && i + 1 < argc) {
+      f32 blend = strtof(argv[++i], 0);
+      if (blend < 0.0f || blend >= 1.0f) {
+        ERROR("Invalid history blend: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->history_blend = blend;
+    } else if (!strcmp(argv[i], "--retune")) {
+      out_options->retune = true;
+    } else if (!strcmp(argv[i], "--self-test")) {
+      out_options->self_test = true;
+    } else if (!strcmp(argv[i], "--headless") && i + 1 < argc) {
+      i64 frame_count = strtol(argv[++i], 0, 10);
+      if (frame_count <= 0) {
+        ERROR("Invalid frame count: '%s'", argv[i]);
+        return false;
+      }
+
+      out_options->headless_frames = frame_count;
+    } else {
+      ERROR("Unknown argument: '%s'", argv[i]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static b8 validateShadows(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator, VulkanQueue *queue,
+                          VulkanCommandPool *command_pool,
+                          FrameResources *frame, u32 particle_count,
+                          glm::vec4 sun_dir, ShadowMode shadow_mode,
+                          f32 *out_error) {
+  device->waitIdle();
+
+  /* the references are computed from the particles the GPU actually shaded,
+   * so the result does not depend on the simulation mode */
+  std::vector<Particle> particles(frame->capacity);
+  std::vector<f32> shadows(frame->capacity);
+  if (!frame->particles_buffer.readDataStaging(device, allocator,
+                                               particles.data(), queue,
+                                               command_pool) ||
+      !frame->shadows_buffer.readDataStaging(device, allocator, shadows.data(),
+                                             queue, command_pool)) {
+    ERROR("Failed to read back shadows!");
+    return false;
+  }
+
+  glm::mat4 light_matrix = lightMatrix(glm::vec3(sun_dir));
+
+  std::vector<f32> reference(particle_count);
+  /* the opacity maps approximate the depth-sorted solve */
+  if (shadow_mode == SHADOW_MODE_DEPTH_SORTED ||
+      shadow_mode == SHADOW_MODE_OPACITY_MAP ||
+      shadow_mode == SHADOW_MODE_FOURIER) {
+    shadowsDepthSorted(particles.data(), particle_count, light_matrix,
+                       SHADOW_MIN_TRANSMITTANCE, reference.data());
+
+    *out_error =
+        shadowsCompare(shadows.data(), reference.data(), particle_count);
+    INFO("Shadow max error vs depth-sorted reference: GPU %g", *out_error);
+
+    return true;
+  }
+
+  if (shadow_mode == SHADOW_MODE_LIGHTS) {
+    LightSource lights[SHADOW_LIGHT_COUNT];
+    lightsBuild(sun_dir, lights);
+    std::vector<f32> light_shadows(particle_count * SHADOW_LIGHT_COUNT);
+    shadowsBruteForceLights(particles.data(), particle_count, lights,
+                            SHADOW_LIGHT_COUNT, light_shadows.data(),
+                            reference.data());
+
+    *out_error =
+        shadowsCompare(shadows.data(), reference.data(), particle_count);
+    INFO("Shadow max error vs multi-light reference: GPU %g", *out_error);
+
+    return true;
+  }
+
+  shadowsBruteForce(particles.data(), particle_count, light_matrix,
+                    reference.data());
+
+  ShadowGrid grid;
+  grid.create(SHADOW_GRID_SIZE,
+              glm::vec4(-SHADOW_GRID_EXTENT, -SHADOW_GRID_EXTENT,
+                        SHADOW_GRID_EXTENT, SHADOW_GRID_EXTENT));
+  grid.build(particles.data(), particle_count, light_matrix);
+  std::vector<f32> binned(particle_count);
+  grid.solve(particles.data(), particle_count, light_matrix,
+             PARTICLE_MAX_RADIUS, binned.data());
+
+  ShadowSolver solver;
+  solver.create(true);
+  solver.project(particles.data(), particle_count, light_matrix);
+  std::vector<f32> solved(particle_count);
+  solver.solve(solved.data());
+
+  *out_error = shadowsCompare(shadows.data(), reference.data(), particle_count);
+  INFO("Shadow max error vs brute force reference: GPU %g, CPU binned %g, "
+       "CPU solver %g",
+       *out_error,
+       shadowsCompare(binned.data(), reference.data(), particle_count),
+       shadowsCompare(solved.data(), reference.data(), particle_count));
+
+  return true;
+}
+
+static void lightsBuild(glm::vec4 sun_dir, LightSource *out_lights) {
+  out_lights[0] = {};
+  out_lights[0].vector = sun_dir;
+  out_lights[0].intensity = 1.0f;
+
+  out_lights[1] = {};
+  out_lights[1].vector = glm::vec4(-sun_dir.x, sun_dir.y, -sun_dir.z, 0.0f);
+  out_lights[1].intensity = 0.5f;
+
+  /* outside the particle volume on either side */
+  out_lights[2] = {};
+  out_lights[2].vector = glm::vec4(6.0f, 4.0f, 0.0f, 1.0f);
+  out_lights[2].intensity = 0.75f;
+
+  out_lights[3] = {};
+  out_lights[3].vector = glm::vec4(-6.0f, 4.0f, 2.0f, 1.0f);
+  out_lights[3].intensity = 0.75f;
+}
+
+static void lightUniformUpdate(VulkanMemoryAllocator *allocator,
+                               FrameResources *frame,
+                               ParticleSystem *particle_system,
+                               f32 pending_time, glm::vec4 sun_dir) {
+  /* the GPU simulation runs ahead of the CPU reference by pending_time, no
+   * particle can have moved further than that at full speed */
+  glm::vec3 bounds_min, bounds_max;
+  particle_system->bounds(&bounds_min, &bounds_max);
+  glm::vec3 padding =
+      glm::vec3(PARTICLE_MAX_RADIUS + PARTICLE_MAX_SPEED * pending_time);
+
+  LightUBO light_ubo = {};
+  light_ubo.light_matrix =
+      lightMatrixFitted(glm::vec3(sun_dir), bounds_min - padding,
+                        bounds_max + padding, &light_ubo.radius_scale);
+  frame->light_uniform_buffer.loadData(allocator, &light_ubo);
+}
+
+static b8 runHeadless(Options *options) {
+  if (options->shadow_mode != SHADOW_MODE_BRUTE_FORCE) {
+    ERROR("Headless runs only support the brute force shadow mode!");
+    return false;
+  }
+
+  ParticleSystem particle_system;
+  particle_system.create(options->particle_count);
+
+  ShadowSolver solver;
+  solver.create(true);
+
+  glm::mat4 light_matrix = lightMatrix(glm::vec3(SUN_DIRECTION));
+  std::vector<f32> shadows(particle_system.count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (u32 i = 0; i < options->headless_frames; ++i) {
+    particle_system.update(FRAME_DELTA_TIME);
+    solver.project(&particle_system, light_matrix);
+    solver.solve(shadows.data());
+  }
+  std::chrono::duration<f64, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  f32 shadow_sum = 0.0f;
+  for (u32 i = 0; i < particle_system.count; ++i) {
+    shadow_sum += shadows[i];
+  }
+
+  INFO("Headless: %u frames of %u particles, %.3f ms per frame, mean shadow "
+       "%g",
+       options->headless_frames, particle_system.count,
+       elapsed.count() / options->headless_frames,
+       shadow_sum / particle_system.count);
+
+  return true;
 }
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "particle_lod.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+
+#include <cstddef>
+
+#define LOD_BINDING_COUNT 4
+
+b8 ParticleLod::create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+                       u32 frame_count, const SphereLod *sphere_lods) {
+  /* binding 0: particles, binding 1: indirect draws, binding 2: instances,
+   * binding 3: per-workgroup offsets of the sorted passes */
+  VkDescriptorSetLayoutBinding bindings[LOD_BINDING_COUNT];
+  for (u32 i = 0; i < LOD_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = LOD_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  /* set 1 only holds the sorted order */
+  VkDescriptorSetLayout descriptor_set_layouts[2];
+  descriptor_set_layouts[0] = VulkanDescriptorSetLayoutCache::layoutCreate(
+      device, &descriptor_set_layout_create_info);
+
+  VkDescriptorSetLayoutBinding single_binding =
+      vulkanDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                       VK_SHADER_STAGE_COMPUTE_BIT);
+  descriptor_set_layout_create_info.bindingCount = 1;
+  descriptor_set_layout_create_info.pBindings = &single_binding;
+  descriptor_set_layouts[1] = VulkanDescriptorSetLayoutCache::layoutCreate(
+      device, &descriptor_set_layout_create_info);
+
+  single_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  instances_descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsLod);
+
+  const char *shader_paths[4] = {
+      "assets/shaders/particle_lod.comp.spv",
+      "assets/shaders/particle_lod_count.comp.spv",
+      "assets/shaders/particle_lod_scan.comp.spv",
+      "assets/shaders/particle_lod_scatter.comp.spv"};
+  VulkanPipeline *pipelines[4] = {&pipeline, &count_pipeline, &scan_pipeline,
+                                  &scatter_pipeline};
+  for (u32 i = 0; i < 4; ++i) {
+    if (!pipelines[i]->createComputeFromFile(
+            device, i == 0 ? 1 : 2, descriptor_set_layouts, 1,
+            &push_constant_range, shader_paths[i])) {
+      ERROR("Failed to create a particle LOD pipeline!");
+      return false;
+    }
+  }
+
+  indirect_count =
+      device->draw_indirect_count && device->draw_indirect_first_instance;
+  if (indirect_count &&
+      !compact_pipeline.createComputeFromFile(
+          device, 1, descriptor_set_layouts, 1, &push_constant_range,
+          "assets/shaders/particle_lod_compact.comp.spv")) {
+    ERROR("Failed to create a particle LOD compaction pipeline!");
+    return false;
+  }
+
+  for (u32 i = 0; i < SPHERE_LOD_COUNT; ++i) {
+    lods[i] = sphere_lods[i];
+  }
+
+  draws_buffers.resize(frame_count);
+  for (u32 i = 0; i < frame_count; ++i) {
+    if (!draws_buffers[i].create(
+            allocator, sizeof(LodDraws),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+            VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+      ERROR("Failed to create an indirect draws buffer!");
+      return false;
+    }
+  }
+
+  instances_buffers.resize(frame_count);
+  block_offsets_buffers.resize(frame_count);
+  capacities.assign(frame_count, 0);
+  descriptor_sets.resize(frame_count);
+  instances_descriptor_sets.resize(frame_count);
+  order_descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources or ParticleSort, so
+   * every set is built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+  order_descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ParticleLod::destroy(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator) {
+  for (u32 i = 0; i < instances_buffers.size(); ++i) {
+    if (capacities[i] > 0) {
+      block_offsets_buffers[i].destroy(allocator);
+      instances_buffers[i].destroy(allocator);
+    }
+  }
+
+  for (u32 i = 0; i < draws_buffers.size(); ++i) {
+    draws_buffers[i].destroy(allocator);
+  }
+
+  if (indirect_count) {
+    compact_pipeline.destroy(device);
+  }
+  scatter_pipeline.destroy(device);
+  scan_pipeline.destroy(device);
+  count_pipeline.destroy(device);
+  pipeline.destroy(device);
+}
+
+b8 ParticleLod::prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+                        std::vector<FrameResources> &frames, u32 frame_index,
+                        u32 particle_count, ParticleSort *sort) {
+  VulkanBuffer &instances_buffer = instances_buffers[frame_index];
+  VulkanBuffer &block_offsets_buffer = block_offsets_buffers[frame_index];
+  u32 &capacity = capacities[frame_index];
+  if (particle_count > capacity) {
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      block_offsets_buffer.destroy(allocator);
+      instances_buffer.destroy(allocator);
+      capacity = 0;
+    }
+
+    /* every LOD has room for all of the particles */
+    u32 group_count = (new_capacity + PARTICLE_LOD_GROUP_SIZE - 1) /
+                      PARTICLE_LOD_GROUP_SIZE;
+    if (!instances_buffer.create(
+            allocator, sizeof(u32) * SPHERE_LOD_COUNT * new_capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY) ||
+        !block_offsets_buffer.create(
+            allocator, sizeof(u32) * SPHERE_LOD_COUNT * group_count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY)) {
+      ERROR("Failed to create LOD instance buffers!");
+      return false;
+    }
+    capacity = new_capacity;
+
+    descriptor_set_generations[frame_index] = 0;
+  }
+
+  VulkanBuffer &draws_buffer = draws_buffers[frame_index];
+  LodDraws *lod_draws = (LodDraws *)draws_buffer.mapped;
+  for (u32 i = 0; i < SPHERE_LOD_COUNT; ++i) {
+    VkDrawIndexedIndirectCommand &draw = lod_draws->draws[i];
+    draw.indexCount = lods[i].index_count;
+    draw.instanceCount = 0;
+    draw.firstIndex = lods[i].first_index;
+    draw.vertexOffset = lods[i].vertex_offset;
+    draw.firstInstance = indirect_count ? i * capacity : 0;
+  }
+  lod_draws->visible_draw_count = 0;
+  draws_buffer.flush(allocator, 0, sizeof(LodDraws));
+
+  VulkanDescriptorSetBuilder builder;
+  if (sort &&
+      order_descriptor_set_generations[frame_index] != sort->generation) {
+    VkDescriptorBufferInfo order_buffer_info =
+        vulkanDescriptorBufferInfo(&sort->order_buffer);
+
+    builder.begin();
+    builder.bufferBind(0, &order_buffer_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+    if (!builder.end(device, &order_descriptor_sets[frame_index])) {
+      ERROR("Failed to build a LOD order descriptor set!");
+      return false;
+    }
+
+    order_descriptor_set_generations[frame_index] = sort->generation;
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[LOD_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&draws_buffer),
+      vulkanDescriptorBufferInfo(&instances_buffer),
+      vulkanDescriptorBufferInfo(&block_offsets_buffer),
+  };
+
+  builder = {};
+  builder.begin();
+  for (u32 i = 0; i < LOD_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build a particle LOD descriptor set!");
+    return false;
+  }
+
+  builder = {};
+  builder.begin();
+  builder.bufferBind(0, &buffer_infos[2], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_VERTEX_BIT);
+  if (!builder.end(device, &instances_descriptor_sets[frame_index])) {
+    ERROR("Failed to build a LOD instances descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+static void lodDispatch(VulkanCommandBuffer *command_buffer,
+                        VulkanPipeline *pipeline,
+                        VkDescriptorSet descriptor_set,
+                        VkDescriptorSet order_descriptor_set,
+                        PushConstantsLod *push_constants, u32 group_count) {
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_set, 0, 0, 0);
+  if (order_descriptor_set) {
+    command_buffer->descriptorSetBind(pipeline,
+                                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      order_descriptor_set, 1, 0, 0);
+  }
+  command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsLod), push_constants);
+  command_buffer->dispatch(group_count, 1);
+}
+
+void ParticleLod::record(VulkanCommandBuffer *command_buffer,
+                         u32 frame_index, u32 particle_count,
+                         const glm::vec4 *frustum_planes, glm::vec3 eye,
+                         f32 pixel_scale, b8 back_to_front) {
+  PushConstantsLod push_constants;
+  for (u32 i = 0; i < 6; ++i) {
+    push_constants.frustum_planes[i] = frustum_planes[i];
+  }
+  push_constants.eye = glm::vec4(eye, pixel_scale);
+  push_constants.particle_count = particle_count;
+  push_constants.lod_capacity = capacities[frame_index];
+  push_constants.back_to_front = back_to_front;
+
+  VkDescriptorSet descriptor_set = descriptor_sets[frame_index];
+  u32 group_count =
+      (particle_count + PARTICLE_LOD_GROUP_SIZE - 1) / PARTICLE_LOD_GROUP_SIZE;
+
+  if (back_to_front) {
+    VkDescriptorSet order_descriptor_set = order_descriptor_sets[frame_index];
+    lodDispatch(command_buffer, &count_pipeline, descriptor_set,
+                order_descriptor_set, &push_constants, group_count);
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    lodDispatch(command_buffer, &scan_pipeline, descriptor_set,
+                order_descriptor_set, &push_constants, 1);
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT);
+    lodDispatch(command_buffer, &scatter_pipeline, descriptor_set,
+                order_descriptor_set, &push_constants, group_count);
+  } else {
+    lodDispatch(command_buffer, &pipeline, descriptor_set, 0,
+                &push_constants, group_count);
+  }
+
+  if (indirect_count) {
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT);
+    lodDispatch(command_buffer, &compact_pipeline, descriptor_set, 0,
+                &push_constants, 1);
+  }
+
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+void ParticleLod::draw(VulkanCommandBuffer *command_buffer,
+                       VulkanPipeline *pipeline, u32 frame_index,
+                       b8 back_to_front) {
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    instances_descriptor_sets[frame_index], 2,
+                                    0, 0);
+
+  if (indirect_count) {
+    u32 instance_base = 0;
+    command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                  sizeof(u32), &instance_base);
+    command_buffer->drawIndexedIndirectCount(
+        &draws_buffers[frame_index], offsetof(LodDraws, visible_draws),
+        &draws_buffers[frame_index], offsetof(LodDraws, visible_draw_count),
+        SPHERE_LOD_COUNT, sizeof(VkDrawIndexedIndirectCommand));
+    return;
+  }
+
+  for (u32 i = 0; i < SPHERE_LOD_COUNT; ++i) {
+    u32 lod = back_to_front ? SPHERE_LOD_COUNT - 1 - i : i;
+    u32 instance_base = lod * capacities[frame_index];
+    command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                  sizeof(u32), &instance_base);
+    command_buffer->drawIndexedIndirect(
+        &draws_buffers[frame_index],
+        sizeof(VkDrawIndexedIndirectCommand) * lod, 1,
+        sizeof(VkDrawIndexedIndirectCommand));
+  }
+}
\ No newline at end of file
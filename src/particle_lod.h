@@ -0,0 +1,97 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "geometry.h"
+#include "particle_sort.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define PARTICLE_LOD_GROUP_SIZE 128
+
+/* 124 bytes, within the 128 every device supports */
+struct PushConstantsLod {
+  glm::vec4 frustum_planes[6];
+  /* xyz: the eye, w: the pixel scale */
+  glm::vec4 eye;
+  u32 particle_count;
+  u32 lod_capacity;
+  u32 back_to_front;
+};
+
+/* mirrors sbDraws in particle_lod.glsl */
+struct LodDraws {
+  VkDrawIndexedIndirectCommand draws[SPHERE_LOD_COUNT];
+  VkDrawIndexedIndirectCommand visible_draws[SPHERE_LOD_COUNT];
+  u32 visible_draw_count;
+};
+
+/* culls every particle's bounding sphere against the camera frustum, then
+ * picks one tessellation of the sphere LOD chain for the visible ones from
+ * their projected radius and appends them to that LOD's instance list.
+ * Off-screen particles are not drawn and distant ones do not pay for the
+ * full mesh. Everything stays on the GPU.
+ *
+ * Back to front, the lists are a stable split of ParticleSort's order by
+ * LOD: a count, a scan and a scatter pass instead of the atomic append. The
+ * LOD is then picked from the distance alone, as if every particle had
+ * PARTICLE_MAX_RADIUS, so the LODs are distance bands and drawing them
+ * coarsest first is exactly farthest first.
+ *
+ * The instance lists share one buffer, LOD i starts at i * capacity. Where
+ * the device has drawIndirectCount and drawIndirectFirstInstance, the
+ * non-empty LODs are packed and drawn with a single
+ * vkCmdDrawIndexedIndirectCount, firstInstance pointing at their lists.
+ * Otherwise every LOD gets its own indexed indirect draw with the base of
+ * its list as a vertex stage push constant */
+struct ParticleLod {
+  VulkanPipeline pipeline;
+  VulkanPipeline count_pipeline;
+  VulkanPipeline scan_pipeline;
+  VulkanPipeline scatter_pipeline;
+  VulkanPipeline compact_pipeline;
+  b8 indirect_count = false;
+  /* the instance list as the mesh vertex shader reads it */
+  VkDescriptorSetLayout instances_descriptor_set_layout;
+  SphereLod lods[SPHERE_LOD_COUNT];
+  std::vector<VulkanBuffer> draws_buffers;
+  std::vector<VulkanBuffer> instances_buffers;
+  std::vector<VulkanBuffer> block_offsets_buffers;
+  /* in particles per LOD, the instance buffers are per frame */
+  std::vector<u32> capacities;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  std::vector<VkDescriptorSet> instances_descriptor_sets;
+  std::vector<VkDescriptorSet> order_descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+  /* ParticleSort::generation of each order descriptor set */
+  std::vector<u32> order_descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 frame_count, const SphereLod *sphere_lods);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, resets
+   * the frame's draws. sort is only needed back to front, after its own
+   * prepare */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count, ParticleSort *sort);
+
+  /* frustum_planes as Camera::getFrustumPlanes returns them, pixel_scale is
+   * projection[1][1] times half the viewport height */
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, const glm::vec4 *frustum_planes,
+              glm::vec3 eye, f32 pixel_scale, b8 back_to_front);
+
+  /* expects the LOD chain's vertex and index buffers to be bound, pipeline
+   * takes the instance base as a vertex stage push constant */
+  void draw(VulkanCommandBuffer *command_buffer, VulkanPipeline *pipeline,
+            u32 frame_index, b8 back_to_front);
+};
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "particle_sort.h"
+
+#include "core/job_system.h"
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define SORT_BINDING_COUNT 3
+
+/* the same keys as particle_sort_keys.comp, ties are broken by the index on
+ * both sides so the two sorts agree */
+static void sortKeysCompute(ParticleSystem *particle_system, glm::vec3 eye,
+                            u64 *pairs) {
+  JobSystem::parallelFor(
+      particle_system->count, PARTICLE_JOB_CHUNK_SIZE,
+      [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+          glm::vec3 offset = particle_system->getPosition(i) - eye;
+          f32 distance2 = glm::dot(offset, offset);
+          u32 bits;
+          memcpy(&bits, &distance2, sizeof(u32));
+          pairs[i] = (u64)(0xFFFFFFFFu - bits) << 32 | i;
+        }
+      });
+}
+
+/* one run per thread sorted in parallel, then merged pairwise with every
+ * round of merges in parallel. The last rounds have fewer merges than
+ * threads */
+static void sortPairs(u64 *pairs, u64 *scratch, u32 count) {
+  u32 run_count = 1;
+  while (run_count < JobSystem::getThreadCount()) {
+    run_count <<= 1;
+  }
+  u32 run_size = (count + run_count - 1) / run_count;
+  if (run_size == 0) {
+    return;
+  }
+
+  JobSystem::parallelFor(run_count, 1, [&](u32 begin, u32 end) {
+    for (u32 run = begin; run < end; ++run) {
+      u32 first = std::min(run * run_size, count);
+      u32 last = std::min(first + run_size, count);
+      std::sort(pairs + first, pairs + last);
+    }
+  });
+
+  u64 *source = pairs;
+  u64 *destination = scratch;
+  for (u32 width = run_size; width < count; width *= 2) {
+    u32 merge_count = (count + 2 * width - 1) / (2 * width);
+    JobSystem::parallelFor(merge_count, 1, [&](u32 begin, u32 end) {
+      for (u32 merge = begin; merge < end; ++merge) {
+        u32 first = merge * 2 * width;
+        u32 middle = std::min(first + width, count);
+        u32 last = std::min(middle + width, count);
+        std::merge(source + first, source + middle, source + middle,
+                   source + last, destination + first);
+      }
+    });
+    std::swap(source, destination);
+  }
+
+  if (source != pairs) {
+    memcpy(pairs, source, sizeof(u64) * count);
+  }
+}
+
+b8 ParticleSort::create(VulkanDevice *device, u32 frame_count) {
+  /* binding 0: particles, binding 1: order, binding 2: keys */
+  VkDescriptorSetLayoutBinding bindings[SORT_BINDING_COUNT];
+  for (u32 i = 0; i < SORT_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = SORT_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsSort);
+
+  if (!keys_pipeline.createComputeFromFile(
+          device, 1, &descriptor_set_layout, 1, &push_constant_range,
+          "assets/shaders/particle_sort_keys.comp.spv") ||
+      !block_pipeline.createComputeFromFile(
+          device, 1, &descriptor_set_layout, 1, &push_constant_range,
+          "assets/shaders/particle_sort_block.comp.spv")) {
+    ERROR("Failed to create a particle sort pipeline!");
+    return false;
+  }
+
+  upload_buffers.resize(frame_count);
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ParticleSort::destroy(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    destroyBuffers(allocator);
+  }
+
+  block_pipeline.destroy(device);
+  keys_pipeline.destroy(device);
+}
+
+void ParticleSort::invalidate() { valid = false; }
+
+b8 ParticleSort::createBuffers(VulkanMemoryAllocator *allocator,
+                               u32 particle_capacity) {
+  capacity = particle_capacity;
+  generation++;
+  valid = false;
+
+  if (!order_buffer.create(allocator, sizeof(u32) * capacity,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           VMA_MEMORY_USAGE_GPU_ONLY) ||
+      !keys_buffer.create(allocator, sizeof(u32) * capacity,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create particle sort buffers!");
+    return false;
+  }
+
+  for (u32 i = 0; i < upload_buffers.size(); ++i) {
+    if (!upload_buffers[i].create(
+            allocator, sizeof(u32) * capacity,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
+            VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+      ERROR("Failed to create a particle order upload buffer!");
+      return false;
+    }
+  }
+
+  pairs.resize(capacity);
+  scratch.resize(capacity);
+
+  return true;
+}
+
+void ParticleSort::destroyBuffers(VulkanMemoryAllocator *allocator) {
+  for (u32 i = 0; i < upload_buffers.size(); ++i) {
+    upload_buffers[i].destroy(allocator);
+  }
+  keys_buffer.destroy(allocator);
+  order_buffer.destroy(allocator);
+  capacity = 0;
+}
+
+b8 ParticleSort::prepare(VulkanDevice *device,
+                         VulkanMemoryAllocator *allocator,
+                         std::vector<FrameResources> &frames,
+                         u32 frame_index, ParticleSystem *particle_system,
+                         glm::vec3 eye, ParticleSortMode mode) {
+  u32 particle_count = particle_system->count;
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be reading the old order */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      destroyBuffers(allocator);
+    }
+    if (!createBuffers(allocator, new_capacity)) {
+      return false;
+    }
+
+    descriptor_set_generations.assign(frames.size(), 0);
+  }
+
+  if (mode == PARTICLE_SORT_GPU && valid) {
+    glm::vec3 bounds_min, bounds_max;
+    particle_system->bounds(&bounds_min, &bounds_max);
+    f32 threshold =
+        PARTICLE_SORT_REBUILD_DISTANCE * glm::length(bounds_max - bounds_min);
+    if (glm::length(eye - rebuild_eye) > threshold) {
+      valid = false;
+    }
+  }
+
+  uploaded = mode == PARTICLE_SORT_CPU || !valid;
+  if (uploaded) {
+    sortKeysCompute(particle_system, eye, pairs.data());
+    sortPairs(pairs.data(), scratch.data(), particle_count);
+
+    u32 *order = (u32 *)upload_buffers[frame_index].mapped;
+    JobSystem::parallelFor(particle_count, PARTICLE_JOB_CHUNK_SIZE,
+                           [&](u32 begin, u32 end) {
+                             for (u32 i = begin; i < end; ++i) {
+                               order[i] = (u32)pairs[i];
+                             }
+                           });
+    upload_buffers[frame_index].flush(allocator, 0,
+                                      sizeof(u32) * particle_count);
+    rebuild_eye = eye;
+    valid = true;
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[SORT_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&order_buffer),
+      vulkanDescriptorBufferInfo(&keys_buffer),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < SORT_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build a particle sort descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+static void sortDispatch(VulkanCommandBuffer *command_buffer,
+                         VulkanPipeline *pipeline,
+                         VkDescriptorSet descriptor_set,
+                         PushConstantsSort *push_constants, u32 group_count) {
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_set, 0, 0, 0);
+  command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsSort), push_constants);
+  command_buffer->dispatch(group_count, 1);
+}
+
+void ParticleSort::record(VulkanCommandBuffer *command_buffer,
+                          u32 frame_index, u32 particle_count,
+                          glm::vec3 eye) {
+  if (uploaded) {
+    /* the previous frame may still be reading the order */
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT);
+    command_buffer->bufferCopy(&upload_buffers[frame_index], &order_buffer,
+                               sizeof(u32) * particle_count);
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    return;
+  }
+
+  PushConstantsSort push_constants;
+  push_constants.eye = glm::vec4(eye, 0.0f);
+  push_constants.particle_count = particle_count;
+  push_constants.offset = 0;
+
+  /* the barrier in front of every dispatch also orders against the previous
+   * frame */
+  sortDispatch(command_buffer, &keys_pipeline, descriptor_sets[frame_index],
+               &push_constants,
+               (particle_count + PARTICLE_SORT_GROUP_SIZE - 1) /
+                   PARTICLE_SORT_GROUP_SIZE);
+
+  for (u32 pass = 0; pass < PARTICLE_SORT_PASSES_PER_FRAME; ++pass) {
+    push_constants.offset =
+        (pass_index++ % 2) * (PARTICLE_SORT_BLOCK_SIZE / 2);
+    if (particle_count <= push_constants.offset) {
+      continue;
+    }
+
+    sortDispatch(command_buffer, &block_pipeline,
+                 descriptor_sets[frame_index], &push_constants,
+                 (particle_count - push_constants.offset +
+                  PARTICLE_SORT_BLOCK_SIZE - 1) /
+                     PARTICLE_SORT_BLOCK_SIZE);
+  }
+
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT);
+}
\ No newline at end of file
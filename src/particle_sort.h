@@ -0,0 +1,95 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define PARTICLE_SORT_GROUP_SIZE 256
+/* mirrored by SORT_BLOCK_SIZE in particle_sort.glsl */
+#define PARTICLE_SORT_BLOCK_SIZE 512
+/* block passes per frame, each moves a particle up to half a block */
+#define PARTICLE_SORT_PASSES_PER_FRAME 4
+/* how far the eye may get from where the order was last rebuilt, as a
+ * fraction of the particle bounds' diagonal, before the GPU order is thrown
+ * away. Past that the passes would take many frames to catch up */
+#define PARTICLE_SORT_REBUILD_DISTANCE 0.1f
+
+enum ParticleSortMode {
+  PARTICLE_SORT_NONE,
+  /* refines the previous frame's order with a few block passes */
+  PARTICLE_SORT_GPU,
+  /* sorts the host copy of the particles from scratch every frame */
+  PARTICLE_SORT_CPU,
+  PARTICLE_SORT_MODE_COUNT,
+};
+
+struct PushConstantsSort {
+  glm::vec4 eye;
+  u32 particle_count;
+  u32 offset;
+};
+
+/* keeps a back to front order of the particles for blending. The GPU sort is
+ * incremental: the order survives from frame to frame and a few passes of a
+ * block-wise odd-even transposition sort move it towards the current
+ * distances. Particles move little between frames, so it stays sorted or
+ * nearly so at a fixed cost per frame as long as the eye does too. Only the
+ * eye's position matters, the distances do not change when it turns.
+ *
+ * Whenever the order is not a permutation of the current particles, after
+ * a resize or before the first GPU frame, or once the eye has moved past
+ * PARTICLE_SORT_REBUILD_DISTANCE, it is rebuilt from a multithreaded
+ * CPU sort of the host copy of the particles, the same one PARTICLE_SORT_CPU
+ * runs every frame. The order buffer is shared by the frames in flight */
+struct ParticleSort {
+  VulkanPipeline keys_pipeline;
+  VulkanPipeline block_pipeline;
+  VulkanBuffer order_buffer;
+  VulkanBuffer keys_buffer;
+  /* per frame, the CPU sorted order on its way to order_buffer */
+  std::vector<VulkanBuffer> upload_buffers;
+  u32 capacity = 0;
+  /* bumped whenever order_buffer is recreated */
+  u32 generation = 0;
+  b8 valid = false;
+  /* the eye the order was last rebuilt for */
+  glm::vec3 rebuild_eye = glm::vec3(0.0f);
+  /* set by prepare, the upload is copied in instead of sorting on the GPU */
+  b8 uploaded = false;
+  u32 pass_index = 0;
+  /* key in the high half, particle index in the low half */
+  std::vector<u64> pairs;
+  std::vector<u64> scratch;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* the order has to be rebuilt before the GPU can refine it again */
+  void invalidate();
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the shared buffers waits for the device to go idle. Sorts on the CPU for
+   * PARTICLE_SORT_CPU and whenever the GPU order is invalid */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             ParticleSystem *particle_system, glm::vec3 eye,
+             ParticleSortMode mode);
+
+  /* leaves order_buffer ready to be read by compute shaders */
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec3 eye);
+
+  b8 createBuffers(VulkanMemoryAllocator *allocator, u32 particle_capacity);
+  void destroyBuffers(VulkanMemoryAllocator *allocator);
+};
\ No newline at end of file
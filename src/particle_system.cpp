@@ -0,0 +1,193 @@
+#include "particle_system.h"
+
+#include "core/cpu.h"
+#include "core/job_system.h"
+#include "core/logger.h"
+
+#ifdef ARCH_X64
+#include <immintrin.h>
+#endif
+
+static void integrateScalar(f32 *positions, const f32 *velocities,
+                            f32 delta_time, u32 count);
+#ifdef ARCH_X64
+static void integrateSSE(f32 *positions, const f32 *velocities,
+                        f32 delta_time, u32 count);
+TARGET_AVX2 static void integrateAVX2(f32 *positions, const f32 *velocities,
+                                      f32 delta_time, u32 count);
+#endif
+
+void ParticleSystem::create(u32 particle_count) {
+  integrate = integrateScalar;
+#ifdef ARCH_X64
+  /* SSE is part of the x64 baseline, only AVX2 has to be checked */
+  integrate = Cpu::hasAVX2() ? integrateAVX2 : integrateSSE;
+#endif
+
+  count = 0;
+  resize(particle_count, glm::vec3(0.0f));
+}
+
+void ParticleSystem::resize(u32 particle_count, glm::vec3 position) {
+  u32 previous_count = count;
+  count = particle_count;
+
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  vx.resize(count);
+  vy.resize(count);
+  vz.resize(count);
+  radius.resize(count);
+  opacity.resize(count);
+
+  if (count > previous_count) {
+    emitRange(previous_count, count - previous_count, position);
+  }
+}
+
+void ParticleSystem::emit(u32 index, glm::vec3 position,
+                          std::minstd_rand &random) {
+  std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+
+  /* uniform point in a ball of radius PARTICLE_MAX_SPEED */
+  glm::vec3 velocity;
+  do {
+    velocity = glm::vec3(unit(random), unit(random), unit(random));
+  } while (glm::dot(velocity, velocity) > 1.0f);
+  velocity = velocity * PARTICLE_MAX_SPEED;
+
+  x[index] = position.x;
+  y[index] = position.y;
+  z[index] = position.z;
+  vx[index] = velocity.x;
+  vy[index] = velocity.y;
+  vz[index] = velocity.z;
+  radius[index] = std::uniform_real_distribution<f32>(
+      PARTICLE_MIN_RADIUS, PARTICLE_MAX_RADIUS)(random);
+  opacity[index] = std::uniform_real_distribution<f32>(0.1f, 1.0f)(random);
+}
+
+void ParticleSystem::emitRange(u32 first, u32 particle_count,
+                               glm::vec3 position) {
+  /* every chunk gets its own generator so the result does not depend on
+   * which worker picked it up */
+  u32 emit_seed = seed++;
+  JobSystem::parallelFor(particle_count, PARTICLE_JOB_CHUNK_SIZE,
+                         [&](u32 begin, u32 end) {
+                           std::minstd_rand random(emit_seed * 7919 + begin +
+                                                   1);
+                           for (u32 i = first + begin; i < first + end; ++i) {
+                             emit(i, position, random);
+                           }
+                         });
+}
+
+void ParticleSystem::createExplosion(glm::vec3 position) {
+  emitRange(0, count, position);
+}
+
+void ParticleSystem::update(f32 delta_time) {
+  JobSystem::parallelFor(count, PARTICLE_JOB_CHUNK_SIZE,
+                         [&](u32 begin, u32 end) {
+                           integrate(x.data() + begin, vx.data() + begin,
+                                     delta_time, end - begin);
+                           integrate(y.data() + begin, vy.data() + begin,
+                                     delta_time, end - begin);
+                           integrate(z.data() + begin, vz.data() + begin,
+                                     delta_time, end - begin);
+                         });
+}
+
+void ParticleSystem::pack(Particle *out_particles, u32 first,
+                          u32 particle_count) {
+  JobSystem::parallelFor(
+      particle_count, PARTICLE_JOB_CHUNK_SIZE, [&](u32 begin, u32 end) {
+        for (u32 i = first + begin; i < first + end; ++i) {
+          Particle &particle = out_particles[i];
+          particle.pos = glm::vec3(x[i], y[i], z[i]);
+          particle._pad0 = 0.0f;
+          particle.radius = radius[i];
+          particle.opacity = opacity[i];
+          particle._pad1 = glm::vec2(0.0f);
+        }
+      });
+}
+
+glm::vec3 ParticleSystem::getPosition(u32 index) {
+  return glm::vec3(x[index], y[index], z[index]);
+}
+
+void ParticleSystem::bounds(glm::vec3 *out_min, glm::vec3 *out_max) {
+  if (count == 0) {
+    *out_min = glm::vec3(0.0f);
+    *out_max = glm::vec3(0.0f);
+    return;
+  }
+
+  /* one partial result per chunk, reduced on the calling thread */
+  u32 chunk_count =
+      (count + PARTICLE_JOB_CHUNK_SIZE - 1) / PARTICLE_JOB_CHUNK_SIZE;
+  std::vector<glm::vec3> chunk_min(chunk_count);
+  std::vector<glm::vec3> chunk_max(chunk_count);
+  JobSystem::parallelFor(
+      count, PARTICLE_JOB_CHUNK_SIZE, [&](u32 begin, u32 end) {
+        glm::vec3 range_min = getPosition(begin);
+        glm::vec3 range_max = range_min;
+        for (u32 i = begin + 1; i < end; ++i) {
+          glm::vec3 position = getPosition(i);
+          range_min = glm::min(range_min, position);
+          range_max = glm::max(range_max, position);
+        }
+        chunk_min[begin / PARTICLE_JOB_CHUNK_SIZE] = range_min;
+        chunk_max[begin / PARTICLE_JOB_CHUNK_SIZE] = range_max;
+      });
+
+  *out_min = chunk_min[0];
+  *out_max = chunk_max[0];
+  for (u32 i = 1; i < chunk_count; ++i) {
+    *out_min = glm::min(*out_min, chunk_min[i]);
+    *out_max = glm::max(*out_max, chunk_max[i]);
+  }
+}
+
+static void integrateScalar(f32 *positions, const f32 *velocities,
+                            f32 delta_time, u32 count) {
+  for (u32 i = 0; i < count; ++i) {
+    positions[i] += velocities[i] * delta_time;
+  }
+}
+
+#ifdef ARCH_X64
+/* streams are 64-byte aligned, so the aligned loads are valid for every full
+ * vector, the tail goes through the scalar path */
+static void integrateSSE(f32 *positions, const f32 *velocities,
+                        f32 delta_time, u32 count) {
+  __m128 dt = _mm_set1_ps(delta_time);
+
+  u32 i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 position = _mm_load_ps(positions + i);
+    __m128 velocity = _mm_load_ps(velocities + i);
+    position = _mm_add_ps(position, _mm_mul_ps(velocity, dt));
+    _mm_store_ps(positions + i, position);
+  }
+
+  integrateScalar(positions + i, velocities + i, delta_time, count - i);
+}
+
+TARGET_AVX2 static void integrateAVX2(f32 *positions, const f32 *velocities,
+                                      f32 delta_time, u32 count) {
+  __m256 dt = _mm256_set1_ps(delta_time);
+
+  u32 i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 position = _mm256_load_ps(positions + i);
+    __m256 velocity = _mm256_load_ps(velocities + i);
+    position = _mm256_add_ps(position, _mm256_mul_ps(velocity, dt));
+    _mm256_store_ps(positions + i, position);
+  }
+
+  integrateScalar(positions + i, velocities + i, delta_time, count - i);
+}
+#endif
\ No newline at end of file
@@ -1,12 +1,28 @@
 #pragma once
 
+#include "core/aligned_allocator.h"
 #include "core/platform.h"
 
 #include <glm/glm.hpp>
-#include <glm/gtc/random.hpp>
+#include <random>
+#include <vector>
 
-#define NUM_PARTICLES 1024
+#define DEFAULT_PARTICLE_COUNT 1024
+/* buffer sizes are u32 products of a capacity and up to 32 bytes per
+ * particle (a Particle, or SHADOW_MAX_LIGHTS shadows), and capacities grow
+ * up to twice the count. 2^26 keeps those under 4 GiB */
+#define PARTICLE_MAX_COUNT (1u << 26)
+#define PARTICLE_STREAM_ALIGNMENT 64
+#define PARTICLE_MIN_RADIUS 0.1f
+/* mirrored by PARTICLE_MAX_RADIUS in particle_lod.glsl */
+#define PARTICLE_MAX_RADIUS 0.5f
+/* emitted velocities are uniform in a ball of this radius */
+#define PARTICLE_MAX_SPEED 0.5f
+/* multiple of 16 floats so that every job starts on a stream alignment
+ * boundary */
+#define PARTICLE_JOB_CHUNK_SIZE 4096
 
+/* GPU layout (std140), only produced when uploading */
 struct Particle {
   glm::vec3 pos;
   f32 _pad0;
@@ -15,22 +31,38 @@ struct Particle {
   glm::vec2 _pad1;
 };
 
+typedef std::vector<f32, AlignedAllocator<f32, PARTICLE_STREAM_ALIGNMENT>>
+    ParticleStream;
+
+typedef void (*ParticleIntegrateFunction)(f32 *positions,
+                                          const f32 *velocities,
+                                          f32 delta_time, u32 count);
+
 struct ParticleSystem {
-  Particle particles[NUM_PARTICLES];
-  glm::vec3 velocities[NUM_PARTICLES];
-
-  void createExplosion(glm::vec3 position) {
-    for (u32 i = 0; i < NUM_PARTICLES; ++i) {
-      particles[i].pos = position;
-      particles[i].radius = glm::linearRand(0.1f, 0.5f);
-      particles[i].opacity = glm::linearRand(0.1f, 1.0f);
-      velocities[i] = glm::ballRand(0.5);
-    }
-  }
-
-  void update(f32 delta_time) {
-    for (u32 i = 0; i < NUM_PARTICLES; ++i) {
-      particles[i].pos += velocities[i] * delta_time;
-    }
-  }
+  ParticleStream x, y, z;
+  ParticleStream vx, vy, vz;
+  ParticleStream radius;
+  ParticleStream opacity;
+  u32 count = 0;
+  u32 seed = 0;
+
+  ParticleIntegrateFunction integrate;
+
+  void create(u32 particle_count);
+
+  /* grows or shrinks the system, newly added particles are emitted from the
+   * given position */
+  void resize(u32 particle_count, glm::vec3 position);
+  void emit(u32 index, glm::vec3 position, std::minstd_rand &random);
+  void emitRange(u32 first, u32 particle_count, glm::vec3 position);
+  void createExplosion(glm::vec3 position);
+
+  void update(f32 delta_time);
+
+  /* writes particles [first, first + particle_count) in the GPU layout */
+  void pack(Particle *out_particles, u32 first, u32 particle_count);
+
+  glm::vec3 getPosition(u32 index);
+  /* AABB of the particle centers, empty systems give a point at the origin */
+  void bounds(glm::vec3 *out_min, glm::vec3 *out_max);
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "particle_weighted_blend.h"
+
+#include "core/file_system.h"
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_shader_module.h"
+
+static b8 pipelineCreate(VulkanDevice *device, VulkanRenderPass *render_pass,
+                         const char *vertex_shader_path,
+                         const char *fragment_shader_path,
+                         u32 descriptor_set_layout_count,
+                         VkDescriptorSetLayout *descriptor_set_layouts,
+                         u32 push_constant_range_count,
+                         VkPushConstantRange *push_constant_range,
+                         VkViewport viewport, VkRect2D scissor,
+                         const VkPipelineColorBlendAttachmentState
+                             *blend_attachment_states,
+                         u32 blend_attachment_count, b8 vertex_pulling,
+                         u32 subpass, VulkanPipeline *pipeline) {
+  VulkanShaderModule vertex_shader_module;
+  VulkanShaderModule fragment_shader_module;
+  if (!vertex_shader_module.create(
+          device, FileSystem::joinPath(vertex_shader_path).c_str())) {
+    ERROR("Failed to load a weighted blend vertex shader!");
+    return false;
+  }
+  if (!fragment_shader_module.create(
+          device, FileSystem::joinPath(fragment_shader_path).c_str())) {
+    ERROR("Failed to load a weighted blend fragment shader!");
+    vertex_shader_module.destroy(device);
+    return false;
+  }
+
+  VkPipelineShaderStageCreateInfo stage_infos[2] = {
+      vulkanPipelineShaderStageCreateInfo(&vertex_shader_module,
+                                          VK_SHADER_STAGE_VERTEX_BIT),
+      vulkanPipelineShaderStageCreateInfo(&fragment_shader_module,
+                                          VK_SHADER_STAGE_FRAGMENT_BIT)};
+
+  /* the depth is only tested, the particles are all transparent */
+  b8 created = pipeline->createGraphics(
+      device, render_pass, descriptor_set_layout_count, descriptor_set_layouts,
+      2, stage_infos, push_constant_range_count, push_constant_range, 0, 0,
+      viewport, scissor, 0, blend_attachment_states, blend_attachment_count,
+      vertex_pulling, false, subpass);
+
+  fragment_shader_module.destroy(device);
+  vertex_shader_module.destroy(device);
+
+  if (!created) {
+    ERROR("Failed to create a weighted blend pipeline!");
+    return false;
+  }
+
+  return true;
+}
+
+b8 ParticleWeightedBlend::create(VulkanDevice *device,
+                                 VulkanMemoryAllocator *allocator,
+                                 VulkanSwapchain *swapchain, u32 width,
+                                 u32 height, u32 descriptor_set_layout_count,
+                                 VkDescriptorSetLayout *descriptor_set_layouts,
+                                 VkPushConstantRange *push_constant_range,
+                                 VkViewport viewport, VkRect2D scissor) {
+  /* never sampled, the resolve reads them as input attachments */
+  if (!accumulation.create(device, allocator,
+                           WEIGHTED_BLEND_ACCUMULATION_FORMAT, width, height,
+                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                               VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT) ||
+      !revealage.create(device, allocator, WEIGHTED_BLEND_REVEALAGE_FORMAT,
+                        width, height,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)) {
+    ERROR("Failed to create the weighted blend targets!");
+    return false;
+  }
+
+  if (!render_pass.createWeightedBlended(device, swapchain,
+                                         WEIGHTED_BLEND_ACCUMULATION_FORMAT,
+                                         WEIGHTED_BLEND_REVEALAGE_FORMAT)) {
+    ERROR("Failed to create the weighted blend render pass!");
+    return false;
+  }
+
+  framebuffers.resize(swapchain->images.size());
+  for (u32 i = 0; i < framebuffers.size(); ++i) {
+    std::vector<VkImageView> attachments = {
+        swapchain->image_views[i], swapchain->depth_texture.view,
+        accumulation.view, revealage.view};
+    if (!framebuffers[i].create(device, &render_pass, attachments, width,
+                                height)) {
+      ERROR("Failed to create a weighted blend framebuffer!");
+      return false;
+    }
+  }
+
+  /* color and coverage add up, revealage keeps the product of every
+   * fragment's transmittance */
+  VkPipelineColorBlendAttachmentState blend_attachment_states[2];
+  VkPipelineColorBlendAttachmentState &accumulation_state =
+      blend_attachment_states[0];
+  accumulation_state.blendEnable = VK_TRUE;
+  accumulation_state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  accumulation_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  accumulation_state.colorBlendOp = VK_BLEND_OP_ADD;
+  accumulation_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  accumulation_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  accumulation_state.alphaBlendOp = VK_BLEND_OP_ADD;
+  accumulation_state.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  VkPipelineColorBlendAttachmentState &revealage_state =
+      blend_attachment_states[1];
+  revealage_state.blendEnable = VK_TRUE;
+  revealage_state.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  revealage_state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+  revealage_state.colorBlendOp = VK_BLEND_OP_ADD;
+  revealage_state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  revealage_state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  revealage_state.alphaBlendOp = VK_BLEND_OP_ADD;
+  revealage_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+
+  if (!pipelineCreate(device, &render_pass, "assets/shaders/particle.vert.spv",
+                      "assets/shaders/particle_weighted_blend.frag.spv",
+                      descriptor_set_layout_count, descriptor_set_layouts, 1,
+                      push_constant_range, viewport, scissor,
+                      blend_attachment_states, 2, false, 0, &pipeline)) {
+    return false;
+  }
+
+  VkDescriptorImageInfo image_infos[2] = {
+      vulkanDescriptorImageInfo(&accumulation,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+      vulkanDescriptorImageInfo(&revealage,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)};
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < 2; ++i) {
+    builder.imageBind(i, &image_infos[i], VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                      VK_SHADER_STAGE_FRAGMENT_BIT);
+  }
+  VkDescriptorSetLayout resolve_descriptor_set_layout;
+  if (!builder.end(device, &resolve_descriptor_set,
+                   &resolve_descriptor_set_layout)) {
+    ERROR("Failed to build the weighted blend resolve descriptor set!");
+    return false;
+  }
+
+  /* the default alpha blending lays the average over the background */
+  if (!pipelineCreate(device, &render_pass,
+                      "assets/shaders/particle_weighted_resolve.vert.spv",
+                      "assets/shaders/particle_weighted_resolve.frag.spv", 1,
+                      &resolve_descriptor_set_layout, 0, 0, viewport, scissor,
+                      0, 1, true, 1, &resolve_pipeline)) {
+    return false;
+  }
+
+  return true;
+}
+
+void ParticleWeightedBlend::destroy(VulkanDevice *device,
+                                    VulkanMemoryAllocator *allocator) {
+  resolve_pipeline.destroy(device);
+  pipeline.destroy(device);
+
+  for (u32 i = 0; i < framebuffers.size(); ++i) {
+    framebuffers[i].destroy(device);
+  }
+  render_pass.destroy(device);
+
+  revealage.destroy(device, allocator);
+  accumulation.destroy(device, allocator);
+}
+
+void ParticleWeightedBlend::begin(VulkanCommandBuffer *command_buffer,
+                                  u32 image_index, glm::vec4 clear_color,
+                                  glm::vec4 render_area) {
+  /* nothing accumulated and everything revealed */
+  VkClearValue clear_values[4] = {};
+  clear_values[0].color.float32[0] = clear_color.r;
+  clear_values[0].color.float32[1] = clear_color.g;
+  clear_values[0].color.float32[2] = clear_color.b;
+  clear_values[0].color.float32[3] = clear_color.a;
+  clear_values[1].depthStencil.depth = 1.0f;
+  clear_values[1].depthStencil.stencil = 0;
+  clear_values[3].color.float32[0] = 1.0f;
+
+  command_buffer->renderPassBegin(&render_pass, &framebuffers[image_index], 4,
+                                  clear_values, render_area);
+}
+
+void ParticleWeightedBlend::end(VulkanCommandBuffer *command_buffer) {
+  command_buffer->subpassNext();
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               &resolve_pipeline);
+  command_buffer->descriptorSetBind(&resolve_pipeline,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    resolve_descriptor_set, 0, 0, 0);
+  command_buffer->draw(3, 1);
+  command_buffer->renderPassEnd();
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "core/platform.h"
+#include "renderer/vulkan/vulkan_framebuffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+#include "renderer/vulkan/vulkan_render_pass.h"
+#include "renderer/vulkan/vulkan_swapchain.h"
+#include "renderer/vulkan/vulkan_texture.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define WEIGHTED_BLEND_ACCUMULATION_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define WEIGHTED_BLEND_REVEALAGE_FORMAT VK_FORMAT_R16_SFLOAT
+
+/* weighted blended order-independent transparency: every particle fragment
+ * adds its premultiplied color, weighted by coverage and depth, into an
+ * accumulation target and multiplies its transmittance into a revealage
+ * target. A second subpass composites the weighted average over the
+ * background. The result does not depend on draw order, so the mesh
+ * particles need no sort, at the price of an approximation where many
+ * fragments of similar depth overlap.
+ *
+ * The targets are shared by the frames in flight like the swapchain's depth
+ * texture, the render pass orders each frame after the previous one */
+struct ParticleWeightedBlend {
+  VulkanTexture accumulation;
+  VulkanTexture revealage;
+  VulkanRenderPass render_pass;
+  /* one per swapchain image */
+  std::vector<VulkanFramebuffer> framebuffers;
+  /* the mesh pipeline with the accumulating fragment shader */
+  VulkanPipeline pipeline;
+  VulkanPipeline resolve_pipeline;
+  VkDescriptorSet resolve_descriptor_set;
+
+  /* descriptor_set_layouts and push_constant_range are the mesh pipeline's,
+   * so the frame's descriptor sets and ParticleLod::draw bind to pipeline */
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            VulkanSwapchain *swapchain, u32 width, u32 height,
+            u32 descriptor_set_layout_count,
+            VkDescriptorSetLayout *descriptor_set_layouts,
+            VkPushConstantRange *push_constant_range, VkViewport viewport,
+            VkRect2D scissor);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* begins the render pass in the accumulation subpass */
+  void begin(VulkanCommandBuffer *command_buffer, u32 image_index,
+             glm::vec4 clear_color, glm::vec4 render_area);
+  /* composites the accumulated particles and ends the render pass */
+  void end(VulkanCommandBuffer *command_buffer);
+};
\ No newline at end of file
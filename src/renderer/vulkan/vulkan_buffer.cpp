@@ -12,7 +12,8 @@
 b8 VulkanBuffer::create(VulkanMemoryAllocator *allocator, u32 buffer_size,
                         VkBufferUsageFlags usage_flags,
                         VkMemoryPropertyFlags memory_flags,
-                        VmaMemoryUsage vma_usage) {
+                        VmaMemoryUsage vma_usage,
+                        VmaAllocationCreateFlags vma_flags) {
   size = buffer_size;
 
   VkBufferCreateInfo buffer_create_info = {};
@@ -26,7 +27,7 @@ b8 VulkanBuffer::create(VulkanMemoryAllocator *allocator, u32 buffer_size,
   buffer_create_info.pQueueFamilyIndices = 0;
 
   VmaAllocationCreateInfo vma_allocation_create_info = {};
-  /* vma_allocation_create_info.flags; */
+  vma_allocation_create_info.flags = vma_flags;
   vma_allocation_create_info.usage = vma_usage;
   vma_allocation_create_info.requiredFlags = memory_flags;
   /*vma_allocation_create_info.preferredFlags;
@@ -35,8 +36,17 @@ b8 VulkanBuffer::create(VulkanMemoryAllocator *allocator, u32 buffer_size,
   vma_allocation_create_info.pUserData;
   vma_allocation_create_info.priority; */
 
+  VmaAllocationInfo allocation_info = {};
   VK_CHECK(vmaCreateBuffer(allocator->handle, &buffer_create_info,
-                           &vma_allocation_create_info, &handle, &memory, 0));
+                           &vma_allocation_create_info, &handle, &memory,
+                           &allocation_info));
+
+  mapped = allocation_info.pMappedData;
+
+  VkMemoryPropertyFlags memory_properties;
+  vmaGetAllocationMemoryProperties(allocator->handle, memory,
+                                   &memory_properties);
+  coherent = memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
   return true;
 }
@@ -46,6 +56,10 @@ void VulkanBuffer::destroy(VulkanMemoryAllocator *allocator) {
 }
 
 void *VulkanBuffer::lock(VulkanMemoryAllocator *allocator) {
+  if (mapped) {
+    return mapped;
+  }
+
   void *data;
   VK_CHECK(vmaMapMemory(allocator->handle, memory, &data));
 
@@ -53,12 +67,37 @@ void *VulkanBuffer::lock(VulkanMemoryAllocator *allocator) {
 }
 
 void VulkanBuffer::unlock(VulkanMemoryAllocator *allocator) {
+  if (mapped) {
+    return;
+  }
+
   vmaUnmapMemory(allocator->handle, memory);
 }
 
+void VulkanBuffer::flush(VulkanMemoryAllocator *allocator, u32 offset,
+                         u32 range_size) {
+  if (coherent) {
+    return;
+  }
+
+  /* vma rounds the range to nonCoherentAtomSize */
+  VK_CHECK(vmaFlushAllocation(allocator->handle, memory, offset, range_size));
+}
+
 b8 VulkanBuffer::loadData(VulkanMemoryAllocator *allocator, void *data) {
-  void *data_ptr = lock(allocator);
-  memcpy(data_ptr, data, size);
+  return loadData(allocator, data, 0, size);
+}
+
+b8 VulkanBuffer::loadData(VulkanMemoryAllocator *allocator, void *data,
+                          u32 offset, u32 range_size) {
+  if (offset + range_size > size) {
+    ERROR("Buffer write out of range!");
+    return false;
+  }
+
+  u8 *data_ptr = (u8 *)lock(allocator);
+  memcpy(data_ptr + offset, data, range_size);
+  flush(allocator, offset, range_size);
   unlock(allocator);
 
   return true;
@@ -89,6 +128,32 @@ bool VulkanBuffer::loadDataStaging(VulkanDevice *device,
   return true;
 }
 
+b8 VulkanBuffer::readDataStaging(VulkanDevice *device,
+                                 VulkanMemoryAllocator *allocator, void *data,
+                                 VulkanQueue *queue,
+                                 VulkanCommandPool *command_pool) {
+  VulkanBuffer staging_buffer;
+  if (!staging_buffer.create(allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                             VMA_MEMORY_USAGE_GPU_TO_CPU,
+                             VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+    ERROR("Failed to create a readback buffer!");
+    return false;
+  }
+
+  copyTo(device, &staging_buffer, queue, command_pool);
+
+  if (!staging_buffer.coherent) {
+    vmaInvalidateAllocation(allocator->handle, staging_buffer.memory, 0, size);
+  }
+
+  memcpy(data, staging_buffer.mapped, size);
+
+  staging_buffer.destroy(allocator);
+
+  return true;
+}
+
 bool VulkanBuffer::copyTo(VulkanDevice *device, VulkanBuffer *dest,
                           VulkanQueue *queue, VulkanCommandPool *command_pool) {
   queue->waitIdle();
@@ -14,19 +14,32 @@ struct VulkanBuffer {
   VkBuffer handle;
   VmaAllocation memory;
   u32 size;
+  /* non-null for the lifetime of the buffer when created with
+   * VMA_ALLOCATION_CREATE_MAPPED_BIT */
+  void *mapped;
+  b8 coherent;
 
   b8 create(VulkanMemoryAllocator *allocator, u32 buffer_size,
             VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags,
-            VmaMemoryUsage vma_usage);
+            VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags = 0);
   void destroy(VulkanMemoryAllocator *allocator);
 
   void *lock(VulkanMemoryAllocator *allocator);
   void unlock(VulkanMemoryAllocator *allocator);
+  /* makes host writes in [offset, offset + range_size) visible to the device,
+   * does nothing for coherent memory */
+  void flush(VulkanMemoryAllocator *allocator, u32 offset, u32 range_size);
 
   b8 loadData(VulkanMemoryAllocator *allocator, void *data);
+  b8 loadData(VulkanMemoryAllocator *allocator, void *data, u32 offset,
+              u32 range_size);
   bool loadDataStaging(VulkanDevice *device, VulkanMemoryAllocator *allocator,
                        void *data, VulkanQueue *queue,
                        VulkanCommandPool *command_pool);
+  /* copies the whole buffer back to the host, waits for the queue */
+  b8 readDataStaging(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+                     void *data, VulkanQueue *queue,
+                     VulkanCommandPool *command_pool);
   bool copyTo(VulkanDevice *device, VulkanBuffer *dest, VulkanQueue *queue,
               VulkanCommandPool *command_pool);
 };
\ No newline at end of file
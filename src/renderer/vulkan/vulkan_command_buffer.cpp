@@ -4,6 +4,7 @@
 #include "vk_check.h"
 #include "vulkan_buffer.h"
 #include "vulkan_command_pool.h"
+#include "vulkan_query_pool.h"
 #include "vulkan_queue.h"
 
 b8 VulkanCommandBuffer::allocate(VulkanDevice *device,
@@ -76,6 +77,15 @@ void VulkanCommandBuffer::renderPassBegin(VulkanRenderPass *render_pass,
   clear_values[1].depthStencil.depth = 1.0f;
   clear_values[1].depthStencil.stencil = 0.0f;
 
+  renderPassBegin(render_pass, framebuffer, clear_values.size(),
+                  clear_values.data(), render_area);
+}
+
+void VulkanCommandBuffer::renderPassBegin(VulkanRenderPass *render_pass,
+                                          VulkanFramebuffer *framebuffer,
+                                          u32 clear_value_count,
+                                          const VkClearValue *clear_values,
+                                          glm::vec4 render_area) {
   VkRenderPassBeginInfo render_pass_begin_info = {};
   render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   render_pass_begin_info.pNext = 0;
@@ -85,13 +95,17 @@ void VulkanCommandBuffer::renderPassBegin(VulkanRenderPass *render_pass,
   render_pass_begin_info.renderArea.offset.y = render_area.y;
   render_pass_begin_info.renderArea.extent.width = render_area.z;
   render_pass_begin_info.renderArea.extent.height = render_area.w;
-  render_pass_begin_info.clearValueCount = clear_values.size();
-  render_pass_begin_info.pClearValues = clear_values.data();
+  render_pass_begin_info.clearValueCount = clear_value_count;
+  render_pass_begin_info.pClearValues = clear_values;
 
   vkCmdBeginRenderPass(handle, &render_pass_begin_info,
                        VK_SUBPASS_CONTENTS_INLINE);
 }
 
+void VulkanCommandBuffer::subpassNext() {
+  vkCmdNextSubpass(handle, VK_SUBPASS_CONTENTS_INLINE);
+}
+
 void VulkanCommandBuffer::renderPassEnd() { vkCmdEndRenderPass(handle); }
 
 void VulkanCommandBuffer::viewportSet(glm::vec4 viewport_values) {
@@ -129,10 +143,35 @@ void VulkanCommandBuffer::drawIndexed(u32 element_count) {
   vkCmdDrawIndexed(handle, element_count, 1, 0, 0, 0);
 }
 
+void VulkanCommandBuffer::drawIndexed(u32 element_count, u32 instance_count) {
+  vkCmdDrawIndexed(handle, element_count, instance_count, 0, 0, 0);
+}
+
+void VulkanCommandBuffer::drawIndexedIndirect(VulkanBuffer *buffer,
+                                              u32 offset, u32 draw_count,
+                                              u32 stride) {
+  vkCmdDrawIndexedIndirect(handle, buffer->handle, offset, draw_count, stride);
+}
+
+void VulkanCommandBuffer::drawIndexedIndirectCount(VulkanBuffer *buffer,
+                                                   u32 offset,
+                                                   VulkanBuffer *count_buffer,
+                                                   u32 count_offset,
+                                                   u32 max_draw_count,
+                                                   u32 stride) {
+  vkCmdDrawIndexedIndirectCount(handle, buffer->handle, offset,
+                                count_buffer->handle, count_offset,
+                                max_draw_count, stride);
+}
+
 void VulkanCommandBuffer::dispatch(u32 local_size_x, u32 local_size_y) {
   vkCmdDispatch(handle, local_size_x, local_size_y, 1);
 }
 
+void VulkanCommandBuffer::dispatchIndirect(VulkanBuffer *buffer, u32 offset) {
+  vkCmdDispatchIndirect(handle, buffer->handle, offset);
+}
+
 void VulkanCommandBuffer::descriptorSetBind(VulkanPipeline *pipeline,
                                             VkPipelineBindPoint bind_point,
                                             VkDescriptorSet descriptor_set,
@@ -159,4 +198,44 @@ void VulkanCommandBuffer::pushConstants(VulkanPipeline *pipeline,
                                         u32 offset, u32 size, void *values) {
   vkCmdPushConstants(handle, pipeline->layout, stage_flags, offset, size,
                      values);
+}
+
+void VulkanCommandBuffer::bufferFill(VulkanBuffer *buffer, u32 value) {
+  vkCmdFillBuffer(handle, buffer->handle, 0, VK_WHOLE_SIZE, value);
+}
+
+void VulkanCommandBuffer::bufferCopy(VulkanBuffer *source,
+                                     VulkanBuffer *destination, u32 size) {
+  VkBufferCopy copy_region = {};
+  copy_region.srcOffset = 0;
+  copy_region.dstOffset = 0;
+  copy_region.size = size;
+
+  vkCmdCopyBuffer(handle, source->handle, destination->handle, 1,
+                  &copy_region);
+}
+
+void VulkanCommandBuffer::queryPoolReset(VulkanQueryPool *query_pool,
+                                         u32 first_query, u32 query_count) {
+  vkCmdResetQueryPool(handle, query_pool->handle, first_query, query_count);
+}
+
+void VulkanCommandBuffer::timestampWrite(VkPipelineStageFlagBits stage,
+                                         VulkanQueryPool *query_pool,
+                                         u32 query) {
+  vkCmdWriteTimestamp(handle, stage, query_pool->handle, query);
+}
+
+void VulkanCommandBuffer::memoryBarrier(VkPipelineStageFlags src_stage_mask,
+                                        VkPipelineStageFlags dst_stage_mask,
+                                        VkAccessFlags src_access_mask,
+                                        VkAccessFlags dst_access_mask) {
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.pNext = 0;
+  barrier.srcAccessMask = src_access_mask;
+  barrier.dstAccessMask = dst_access_mask;
+
+  vkCmdPipelineBarrier(handle, src_stage_mask, dst_stage_mask, 0, 1, &barrier,
+                       0, 0, 0, 0);
 }
\ No newline at end of file
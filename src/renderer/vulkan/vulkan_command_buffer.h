@@ -11,6 +11,7 @@
 
 struct VulkanBuffer;
 struct VulkanCommandPool;
+struct VulkanQueryPool;
 struct VulkanQueue;
 
 struct VulkanCommandBuffer {
@@ -30,13 +31,27 @@ struct VulkanCommandBuffer {
   void renderPassBegin(VulkanRenderPass *render_pass,
                        VulkanFramebuffer *framebuffer, glm::vec4 clear_color,
                        glm::vec4 render_area);
+  /* one clear value per attachment of the render pass */
+  void renderPassBegin(VulkanRenderPass *render_pass,
+                       VulkanFramebuffer *framebuffer, u32 clear_value_count,
+                       const VkClearValue *clear_values,
+                       glm::vec4 render_area);
+  void subpassNext();
   void renderPassEnd();
   void viewportSet(glm::vec4 viewport_values);
   void scissorSet(glm::vec4 scissor_values);
   void pipelineBind(VkPipelineBindPoint bind_point, VulkanPipeline *pipeline);
   void draw(u32 vertex_count, u32 instance_count);
   void drawIndexed(u32 element_count);
+  void drawIndexed(u32 element_count, u32 instance_count);
+  void drawIndexedIndirect(VulkanBuffer *buffer, u32 offset, u32 draw_count,
+                           u32 stride);
+  void drawIndexedIndirectCount(VulkanBuffer *buffer, u32 offset,
+                                VulkanBuffer *count_buffer, u32 count_offset,
+                                u32 max_draw_count, u32 stride);
   void dispatch(u32 local_size_x, u32 local_size_y);
+  /* reads a VkDispatchIndirectCommand at offset */
+  void dispatchIndirect(VulkanBuffer *buffer, u32 offset);
   void descriptorSetBind(VulkanPipeline *pipeline,
                          VkPipelineBindPoint bind_point,
                          VkDescriptorSet descriptor_set, u32 set_index,
@@ -45,4 +60,14 @@ struct VulkanCommandBuffer {
   void bufferIndexBind(VulkanBuffer *buffer, u32 offset);
   void pushConstants(VulkanPipeline *pipeline, VkShaderStageFlags stage_flags,
                      u32 offset, u32 size, void *values);
+  void bufferFill(VulkanBuffer *buffer, u32 value);
+  void bufferCopy(VulkanBuffer *source, VulkanBuffer *destination, u32 size);
+  void queryPoolReset(VulkanQueryPool *query_pool, u32 first_query,
+                      u32 query_count);
+  void timestampWrite(VkPipelineStageFlagBits stage,
+                      VulkanQueryPool *query_pool, u32 query);
+  void memoryBarrier(VkPipelineStageFlags src_stage_mask,
+                     VkPipelineStageFlags dst_stage_mask,
+                     VkAccessFlags src_access_mask,
+                     VkAccessFlags dst_access_mask);
 };
\ No newline at end of file
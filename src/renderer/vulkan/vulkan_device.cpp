@@ -107,8 +107,39 @@ b8 VulkanDevice::create(VulkanInstance *instance, VulkanSurface *surface) {
     vkGetPhysicalDeviceMemoryProperties(current_physical_device,
                                         &device_memory);
 
+    VkPhysicalDeviceSubgroupProperties subgroup_properties = {};
+    subgroup_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    if (device_properties.apiVersion >= VK_API_VERSION_1_1) {
+      VkPhysicalDeviceProperties2 device_properties2 = {};
+      device_properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      device_properties2.pNext = &subgroup_properties;
+      vkGetPhysicalDeviceProperties2(current_physical_device,
+                                     &device_properties2);
+    }
+
+    VkPhysicalDeviceVulkan11Features device_features11 = {};
+    device_features11.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceVulkan12Features device_features12 = {};
+    device_features12.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (device_properties.apiVersion >= VK_API_VERSION_1_2) {
+      device_features11.pNext = &device_features12;
+
+      VkPhysicalDeviceFeatures2 device_features2 = {};
+      device_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      device_features2.pNext = &device_features11;
+      vkGetPhysicalDeviceFeatures2(current_physical_device, &device_features2);
+    }
+
     physical_device = current_physical_device;
     properties = device_properties;
+    subgroup = subgroup_properties;
+    storage_buffer_16bit = device_features11.storageBuffer16BitAccess;
+    shader_float16 = device_features12.shaderFloat16;
+    draw_indirect_count = device_features12.drawIndirectCount;
+    draw_indirect_first_instance = device_features.drawIndirectFirstInstance;
     features = device_features;
     memory = device_memory;
     graphics_family_index = device_graphics_family_index;
@@ -162,10 +193,25 @@ b8 VulkanDevice::create(VulkanInstance *instance, VulkanSurface *surface) {
 #endif
 
   VkPhysicalDeviceFeatures device_features = {};
+  device_features.drawIndirectFirstInstance = draw_indirect_first_instance;
+
+  VkPhysicalDeviceVulkan12Features device_features12 = {};
+  device_features12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  device_features12.shaderFloat16 = shader_float16;
+  device_features12.drawIndirectCount = draw_indirect_count;
+
+  VkPhysicalDeviceVulkan11Features device_features11 = {};
+  device_features11.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+  device_features11.pNext = &device_features12;
+  device_features11.storageBuffer16BitAccess = storage_buffer_16bit;
 
   VkDeviceCreateInfo device_create_info = {};
   device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  device_create_info.pNext = 0;
+  /* the feature structs are only valid on Vulkan 1.2 devices */
+  device_create_info.pNext =
+      properties.apiVersion >= VK_API_VERSION_1_2 ? &device_features11 : 0;
   device_create_info.flags = 0;
   device_create_info.queueCreateInfoCount = queue_create_infos.size();
   device_create_info.pQueueCreateInfos = queue_create_infos.data();
@@ -185,6 +231,13 @@ void VulkanDevice::destroy() { vkDestroyDevice(logical_device, 0); }
 
 void VulkanDevice::waitIdle() { vkDeviceWaitIdle(logical_device); }
 
+b8 VulkanDevice::subgroupSupports(VkShaderStageFlags stages,
+                                  VkSubgroupFeatureFlags operations) {
+  return subgroup.subgroupSize > 0 &&
+         (subgroup.supportedStages & stages) == stages &&
+         (subgroup.supportedOperations & operations) == operations;
+}
+
 static b8
 deviceExtensionsAvailable(VkPhysicalDevice physical_device,
                           std::vector<const char *> &required_extensions) {
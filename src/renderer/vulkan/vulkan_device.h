@@ -15,6 +15,15 @@ struct VulkanDevice {
   VkPhysicalDeviceProperties properties;
   VkPhysicalDeviceFeatures features;
   VkPhysicalDeviceMemoryProperties memory;
+  /* zeroed on Vulkan 1.0 devices */
+  VkPhysicalDeviceSubgroupProperties subgroup;
+  /* optional features, enabled on the logical device when available. Both
+   * need a Vulkan 1.2 device */
+  b8 storage_buffer_16bit = false;
+  b8 shader_float16 = false;
+  /* drawIndirectCount needs a Vulkan 1.2 device */
+  b8 draw_indirect_count = false;
+  b8 draw_indirect_first_instance = false;
 
   u32 graphics_family_index;
   u32 present_family_index;
@@ -24,4 +33,8 @@ struct VulkanDevice {
   b8 create(VulkanInstance *instance, VulkanSurface *surface);
   void destroy();
   void waitIdle();
+
+  /* every operation in operations is available in every stage in stages */
+  b8 subgroupSupports(VkShaderStageFlags stages,
+                      VkSubgroupFeatureFlags operations);
 };
@@ -1,5 +1,7 @@
 #include "vulkan_pipeline.h"
 
+#include "core/file_system.h"
+#include "core/logger.h"
 #include "vk_check.h"
 #include "vulkan_shader_module.h"
 
@@ -9,7 +11,11 @@ b8 VulkanPipeline::createGraphics(
     VkDescriptorSetLayout *descriptor_set_layouts, u32 stage_info_count,
     VkPipelineShaderStageCreateInfo *stage_infos, u32 push_constants_count,
     VkPushConstantRange *push_constants, u32 dynamic_state_count,
-    VkDynamicState *dynamic_states, VkViewport viewport, VkRect2D scissor) {
+    VkDynamicState *dynamic_states, VkViewport viewport, VkRect2D scissor,
+    const VkSpecializationInfo *specialization_info,
+    const VkPipelineColorBlendAttachmentState *blend_attachment_states,
+    u32 blend_attachment_count, b8 vertex_pulling, b8 depth_write,
+    u32 subpass) {
   VkPipelineViewportStateCreateInfo viewport_state = {};
   viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewport_state.pNext = 0;
@@ -53,7 +59,7 @@ b8 VulkanPipeline::createGraphics(
   depth_stencil.pNext = 0;
   depth_stencil.flags = 0;
   depth_stencil.depthTestEnable = VK_TRUE;
-  depth_stencil.depthWriteEnable = VK_TRUE;
+  depth_stencil.depthWriteEnable = depth_write ? VK_TRUE : VK_FALSE;
   depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
   depth_stencil.depthBoundsTestEnable = VK_FALSE;
   depth_stencil.stencilTestEnable = VK_FALSE;
@@ -82,8 +88,13 @@ b8 VulkanPipeline::createGraphics(
   color_blend_state_create_info.flags = 0;
   color_blend_state_create_info.logicOpEnable = VK_FALSE;
   color_blend_state_create_info.logicOp = VK_LOGIC_OP_COPY;
-  color_blend_state_create_info.attachmentCount = 1;
-  color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
+  if (blend_attachment_states) {
+    color_blend_state_create_info.attachmentCount = blend_attachment_count;
+    color_blend_state_create_info.pAttachments = blend_attachment_states;
+  } else {
+    color_blend_state_create_info.attachmentCount = 1;
+    color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
+  }
   /* color_blend_state_create_info.blendConstants[4]; */
 
   VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
@@ -113,13 +124,16 @@ b8 VulkanPipeline::createGraphics(
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertex_input_info.pNext = 0;
   vertex_input_info.flags = 0;
-  vertex_input_info.vertexBindingDescriptionCount = 1;
-  vertex_input_info.pVertexBindingDescriptions =
-      &vertex_input_binding_description;
-  vertex_input_info.vertexAttributeDescriptionCount =
-      vertex_input_attribute_descriptions.size();
-  vertex_input_info.pVertexAttributeDescriptions =
-      vertex_input_attribute_descriptions.data();
+  /* vertex pulling shaders fetch everything from storage buffers */
+  if (!vertex_pulling) {
+    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.pVertexBindingDescriptions =
+        &vertex_input_binding_description;
+    vertex_input_info.vertexAttributeDescriptionCount =
+        vertex_input_attribute_descriptions.size();
+    vertex_input_info.pVertexAttributeDescriptions =
+        vertex_input_attribute_descriptions.data();
+  }
 
   VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
   input_assembly.sType =
@@ -146,8 +160,16 @@ b8 VulkanPipeline::createGraphics(
   pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipeline_create_info.pNext = 0;
   pipeline_create_info.flags = 0;
-  pipeline_create_info.stageCount = stage_info_count;
-  pipeline_create_info.pStages = stage_infos;
+  std::vector<VkPipelineShaderStageCreateInfo> stages(
+      stage_infos, stage_infos + stage_info_count);
+  if (specialization_info) {
+    for (u32 i = 0; i < stages.size(); ++i) {
+      stages[i].pSpecializationInfo = specialization_info;
+    }
+  }
+
+  pipeline_create_info.stageCount = stages.size();
+  pipeline_create_info.pStages = stages.data();
   pipeline_create_info.pVertexInputState = &vertex_input_info;
   pipeline_create_info.pInputAssemblyState = &input_assembly;
   pipeline_create_info.pTessellationState = 0;
@@ -159,7 +181,7 @@ b8 VulkanPipeline::createGraphics(
   pipeline_create_info.pDynamicState = &dynamic_state_create_info;
   pipeline_create_info.layout = layout;
   pipeline_create_info.renderPass = render_pass->handle;
-  pipeline_create_info.subpass = 0;
+  pipeline_create_info.subpass = subpass;
   pipeline_create_info.basePipelineHandle = 0;
   pipeline_create_info.basePipelineIndex = -1;
 
@@ -169,12 +191,11 @@ b8 VulkanPipeline::createGraphics(
   return true;
 }
 
-b8 VulkanPipeline::createCompute(VulkanDevice *device,
-                                 u32 descriptor_set_layout_count,
-                                 VkDescriptorSetLayout *descriptor_set_layouts,
-                                 u32 push_constants_count,
-                                 VkPushConstantRange *push_constants,
-                                 VkPipelineShaderStageCreateInfo stage) {
+b8 VulkanPipeline::createCompute(
+    VulkanDevice *device, u32 descriptor_set_layout_count,
+    VkDescriptorSetLayout *descriptor_set_layouts, u32 push_constants_count,
+    VkPushConstantRange *push_constants, VkPipelineShaderStageCreateInfo stage,
+    const VkSpecializationInfo *specialization_info) {
   VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
   pipeline_layout_create_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -192,6 +213,10 @@ b8 VulkanPipeline::createCompute(VulkanDevice *device,
   pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
   pipeline_create_info.pNext = 0;
   pipeline_create_info.flags = 0;
+  if (specialization_info) {
+    stage.pSpecializationInfo = specialization_info;
+  }
+
   pipeline_create_info.stage = stage;
   pipeline_create_info.layout = layout;
   pipeline_create_info.basePipelineHandle = 0;
@@ -203,6 +228,32 @@ b8 VulkanPipeline::createCompute(VulkanDevice *device,
   return true;
 }
 
+b8 VulkanPipeline::createComputeFromFile(
+    VulkanDevice *device, u32 descriptor_set_layout_count,
+    VkDescriptorSetLayout *descriptor_set_layouts, u32 push_constants_count,
+    VkPushConstantRange *push_constants, const char *shader_path,
+    const VkSpecializationInfo *specialization_info) {
+  VulkanShaderModule shader_module;
+  if (!shader_module.create(device,
+                            FileSystem::joinPath(shader_path).c_str())) {
+    ERROR("Failed to create a shader module from '%s'!", shader_path);
+    return false;
+  }
+
+  VkPipelineShaderStageCreateInfo stage_create_info =
+      vulkanPipelineShaderStageCreateInfo(&shader_module,
+                                          VK_SHADER_STAGE_COMPUTE_BIT);
+
+  b8 created = createCompute(device, descriptor_set_layout_count,
+                             descriptor_set_layouts, push_constants_count,
+                             push_constants, stage_create_info,
+                             specialization_info);
+
+  shader_module.destroy(device);
+
+  return created;
+}
+
 void VulkanPipeline::destroy(VulkanDevice *device) {
   vkDestroyPipeline(device->logical_device, handle, 0);
   vkDestroyPipelineLayout(device->logical_device, layout, 0);
@@ -222,4 +273,24 @@ vulkanPipelineShaderStageCreateInfo(VulkanShaderModule *shader_module,
   pipeline_shader_stage_create_info.pSpecializationInfo = 0;
 
   return pipeline_shader_stage_create_info;
+}
+
+void VulkanSpecialization::constantSet(u32 constant_id, u32 value) {
+  VkSpecializationMapEntry entry = {};
+  entry.constantID = constant_id;
+  entry.offset = data.size() * sizeof(u32);
+  entry.size = sizeof(u32);
+
+  entries.emplace_back(entry);
+  data.emplace_back(value);
+}
+
+VkSpecializationInfo VulkanSpecialization::getInfo() {
+  VkSpecializationInfo specialization_info = {};
+  specialization_info.mapEntryCount = entries.size();
+  specialization_info.pMapEntries = entries.data();
+  specialization_info.dataSize = data.size() * sizeof(u32);
+  specialization_info.pData = data.data();
+
+  return specialization_info;
 }
\ No newline at end of file
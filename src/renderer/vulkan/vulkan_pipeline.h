@@ -8,24 +8,51 @@
 
 struct VulkanShaderModule;
 
+/* 32-bit specialization constants, the info returned by getInfo points into
+ * the struct and has to outlive pipeline creation */
+struct VulkanSpecialization {
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<u32> data;
+
+  void constantSet(u32 constant_id, u32 value);
+  VkSpecializationInfo getInfo();
+};
+
 struct VulkanPipeline {
   VkPipeline handle;
   VkPipelineLayout layout;
 
-  b8 createGraphics(VulkanDevice *device, VulkanRenderPass *render_pass,
-                    u32 descriptor_set_layout_count,
-                    VkDescriptorSetLayout *descriptor_set_layouts,
-                    u32 stage_info_count,
-                    VkPipelineShaderStageCreateInfo *stage_infos,
-                    u32 push_constants_count,
-                    VkPushConstantRange *push_constants,
-                    u32 dynamic_state_count, VkDynamicState *dynamic_states,
-                    VkViewport viewport, VkRect2D scissor);
+  /* specialization_info, when given, applies to every stage.
+   * blend_attachment_states, one per color attachment, replace the default
+   * alpha blending of a single attachment. depth_write off still tests
+   * against the depth buffer, for sorted transparent geometry. subpass is
+   * the index of the render pass subpass the pipeline is used in */
+  b8 createGraphics(
+      VulkanDevice *device, VulkanRenderPass *render_pass,
+      u32 descriptor_set_layout_count,
+      VkDescriptorSetLayout *descriptor_set_layouts, u32 stage_info_count,
+      VkPipelineShaderStageCreateInfo *stage_infos, u32 push_constants_count,
+      VkPushConstantRange *push_constants, u32 dynamic_state_count,
+      VkDynamicState *dynamic_states, VkViewport viewport, VkRect2D scissor,
+      const VkSpecializationInfo *specialization_info = 0,
+      const VkPipelineColorBlendAttachmentState *blend_attachment_states = 0,
+      u32 blend_attachment_count = 1, b8 vertex_pulling = false,
+      b8 depth_write = true, u32 subpass = 0);
   b8 createCompute(VulkanDevice *device, u32 descriptor_set_layout_count,
                    VkDescriptorSetLayout *descriptor_set_layouts,
                    u32 push_constants_count,
                    VkPushConstantRange *push_constants,
-                   VkPipelineShaderStageCreateInfo stage);
+                   VkPipelineShaderStageCreateInfo stage,
+                   const VkSpecializationInfo *specialization_info = 0);
+  /* loads the SPIR-V at shader_path, the module is released once the pipeline
+   * is created */
+  b8 createComputeFromFile(VulkanDevice *device,
+                           u32 descriptor_set_layout_count,
+                           VkDescriptorSetLayout *descriptor_set_layouts,
+                           u32 push_constants_count,
+                           VkPushConstantRange *push_constants,
+                           const char *shader_path,
+                           const VkSpecializationInfo *specialization_info = 0);
   void destroy(VulkanDevice *device);
 };
 
@@ -0,0 +1,35 @@
+#include "vulkan_query_pool.h"
+
+#include "vk_check.h"
+
+b8 VulkanQueryPool::create(VulkanDevice *device, VkQueryType type,
+                           u32 query_count) {
+  count = query_count;
+
+  VkQueryPoolCreateInfo query_pool_create_info = {};
+  query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_create_info.pNext = 0;
+  query_pool_create_info.flags = 0;
+  query_pool_create_info.queryType = type;
+  query_pool_create_info.queryCount = count;
+  query_pool_create_info.pipelineStatistics = 0;
+
+  VK_CHECK(vkCreateQueryPool(device->logical_device, &query_pool_create_info,
+                             0, &handle));
+
+  return true;
+}
+
+void VulkanQueryPool::destroy(VulkanDevice *device) {
+  vkDestroyQueryPool(device->logical_device, handle, 0);
+}
+
+b8 VulkanQueryPool::results(VulkanDevice *device, u32 first_query,
+                            u32 query_count, u64 *out_results) {
+  VkResult result = vkGetQueryPoolResults(
+      device->logical_device, handle, first_query, query_count,
+      sizeof(u64) * query_count, out_results, sizeof(u64),
+      VK_QUERY_RESULT_64_BIT);
+
+  return result == VK_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "core/platform.h"
+#include "vulkan_device.h"
+
+#include <vulkan/vulkan.h>
+
+struct VulkanQueryPool {
+  VkQueryPool handle;
+  u32 count;
+
+  b8 create(VulkanDevice *device, VkQueryType type, u32 query_count);
+  void destroy(VulkanDevice *device);
+
+  /* false while any of the queries is still unavailable, does not wait */
+  b8 results(VulkanDevice *device, u32 first_query, u32 query_count,
+             u64 *out_results);
+};
\ No newline at end of file
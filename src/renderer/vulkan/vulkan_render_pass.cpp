@@ -81,6 +81,192 @@ b8 VulkanRenderPass::create(VulkanDevice *device, VulkanSwapchain *swapchain) {
   return true;
 }
 
+b8 VulkanRenderPass::createOffscreen(VulkanDevice *device,
+                                     VkFormat color_format,
+                                     u32 color_attachment_count) {
+  std::vector<VkAttachmentDescription> attachments(color_attachment_count);
+  std::vector<VkAttachmentReference> color_attachment_references(
+      color_attachment_count);
+  for (u32 i = 0; i < color_attachment_count; ++i) {
+    attachments[i].flags = 0;
+    attachments[i].format = color_format;
+    attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    color_attachment_references[i].attachment = i;
+    color_attachment_references[i].layout =
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+
+  VkSubpassDescription subpass_description = {};
+  subpass_description.flags = 0;
+  subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass_description.inputAttachmentCount = 0;
+  subpass_description.pInputAttachments = 0;
+  subpass_description.colorAttachmentCount = color_attachment_count;
+  subpass_description.pColorAttachments = color_attachment_references.data();
+  subpass_description.pResolveAttachments = 0;
+  subpass_description.pDepthStencilAttachment = 0;
+  subpass_description.preserveAttachmentCount = 0;
+  subpass_description.pPreserveAttachments = 0;
+
+  /* the previous contents may still be sampled by compute, the new ones are
+   * sampled by compute next */
+  VkSubpassDependency dependencies[2];
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dependencyFlags = 0;
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  dependencies[1].dependencyFlags = 0;
+
+  VkRenderPassCreateInfo render_pass_create_info = {};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.pNext = 0;
+  render_pass_create_info.flags = 0;
+  render_pass_create_info.attachmentCount = color_attachment_count;
+  render_pass_create_info.pAttachments = attachments.data();
+  render_pass_create_info.subpassCount = 1;
+  render_pass_create_info.pSubpasses = &subpass_description;
+  render_pass_create_info.dependencyCount = 2;
+  render_pass_create_info.pDependencies = dependencies;
+
+  VK_CHECK(vkCreateRenderPass(device->logical_device, &render_pass_create_info,
+                              0, &handle));
+
+  return true;
+}
+
+b8 VulkanRenderPass::createWeightedBlended(VulkanDevice *device,
+                                           VulkanSwapchain *swapchain,
+                                           VkFormat accumulation_format,
+                                           VkFormat revealage_format) {
+  VkFormat formats[4] = {swapchain->image_format.format,
+                         swapchain->depth_texture.format, accumulation_format,
+                         revealage_format};
+  VkAttachmentDescription attachments[4];
+  for (u32 i = 0; i < 4; ++i) {
+    attachments[i].flags = 0;
+    attachments[i].format = formats[i];
+    attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    /* the accumulation targets only live for the length of the pass */
+    attachments[i].storeOp = i < 2 ? VK_ATTACHMENT_STORE_OP_STORE
+                                   : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference accumulation_attachment_references[2];
+  accumulation_attachment_references[0].attachment = 2;
+  accumulation_attachment_references[0].layout =
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  accumulation_attachment_references[1].attachment = 3;
+  accumulation_attachment_references[1].layout =
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference depth_attachment_reference;
+  depth_attachment_reference.attachment = 1;
+  depth_attachment_reference.layout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference input_attachment_references[2];
+  input_attachment_references[0].attachment = 2;
+  input_attachment_references[0].layout =
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  input_attachment_references[1].attachment = 3;
+  input_attachment_references[1].layout =
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentReference color_attachment_reference = {};
+  color_attachment_reference.attachment = 0;
+  color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass_descriptions[2] = {};
+  subpass_descriptions[0].flags = 0;
+  subpass_descriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass_descriptions[0].colorAttachmentCount = 2;
+  subpass_descriptions[0].pColorAttachments =
+      accumulation_attachment_references;
+  subpass_descriptions[0].pDepthStencilAttachment = &depth_attachment_reference;
+  subpass_descriptions[1].flags = 0;
+  subpass_descriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass_descriptions[1].inputAttachmentCount = 2;
+  subpass_descriptions[1].pInputAttachments = input_attachment_references;
+  subpass_descriptions[1].colorAttachmentCount = 1;
+  subpass_descriptions[1].pColorAttachments = &color_attachment_reference;
+
+  /* the accumulation targets and depth are shared by the frames in flight,
+   * the previous frame may still be resolving from them */
+  VkSubpassDependency dependencies[4];
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dependencyFlags = 0;
+  dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].srcAccessMask = 0;
+  dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dependencyFlags = 0;
+  dependencies[2].srcSubpass = 0;
+  dependencies[2].dstSubpass = 1;
+  dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+  dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+  dependencies[3].srcSubpass = 1;
+  dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[3].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  dependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[3].dstAccessMask = 0;
+  dependencies[3].dependencyFlags = 0;
+
+  VkRenderPassCreateInfo render_pass_create_info = {};
+  render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_create_info.pNext = 0;
+  render_pass_create_info.flags = 0;
+  render_pass_create_info.attachmentCount = 4;
+  render_pass_create_info.pAttachments = attachments;
+  render_pass_create_info.subpassCount = 2;
+  render_pass_create_info.pSubpasses = subpass_descriptions;
+  render_pass_create_info.dependencyCount = 4;
+  render_pass_create_info.pDependencies = dependencies;
+
+  VK_CHECK(vkCreateRenderPass(device->logical_device, &render_pass_create_info,
+                              0, &handle));
+
+  return true;
+}
+
 void VulkanRenderPass::destroy(VulkanDevice *device) {
   vkDestroyRenderPass(device->logical_device, handle, 0);
 }
\ No newline at end of file
@@ -10,5 +10,16 @@ struct VulkanRenderPass {
   VkRenderPass handle;
 
   b8 create(VulkanDevice *device, VulkanSwapchain *swapchain);
+  /* cleared color attachments of one format that compute shaders sample once
+   * the pass ends, no depth */
+  b8 createOffscreen(VulkanDevice *device, VkFormat color_format,
+                     u32 color_attachment_count = 1);
+  /* weighted blended transparency: subpass 0 accumulates into attachments 2
+   * (weighted color) and 3 (revealage) against the depth of attachment 1,
+   * subpass 1 reads them as input attachments and composites into the
+   * swapchain image, attachment 0 */
+  b8 createWeightedBlended(VulkanDevice *device, VulkanSwapchain *swapchain,
+                           VkFormat accumulation_format,
+                           VkFormat revealage_format);
   void destroy(VulkanDevice *device);
 };
\ No newline at end of file
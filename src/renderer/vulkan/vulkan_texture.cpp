@@ -10,7 +10,8 @@
 
 b8 VulkanTexture::create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
                          VkFormat texture_format, u32 texture_width,
-                         u32 texture_height, VkImageUsageFlags usage_flags) {
+                         u32 texture_height, VkImageUsageFlags usage_flags,
+                         VkSamplerAddressMode address_mode) {
   if (usage_flags & VK_IMAGE_USAGE_STORAGE_BIT) {
     VkFormatProperties format_properties;
     vkGetPhysicalDeviceFormatProperties(device->physical_device, format,
@@ -87,9 +88,9 @@ b8 VulkanTexture::create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
   sampler_create_info.magFilter = VK_FILTER_LINEAR;
   sampler_create_info.minFilter = VK_FILTER_LINEAR;
   sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-  sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  sampler_create_info.addressModeU = address_mode;
+  sampler_create_info.addressModeV = address_mode;
+  sampler_create_info.addressModeW = address_mode;
   sampler_create_info.mipLodBias = 0.0f;
   sampler_create_info.anisotropyEnable = VK_FALSE;
   sampler_create_info.maxAnisotropy = 1.0f;
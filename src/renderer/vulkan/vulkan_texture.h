@@ -22,7 +22,8 @@ struct VulkanTexture {
 
   b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
             VkFormat texture_format, u32 texture_width, u32 texture_height,
-            VkImageUsageFlags usage_flags);
+            VkImageUsageFlags usage_flags,
+            VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
   void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
 
   b8 writeData(VulkanDevice *device, void *pixels,
@@ -0,0 +1,177 @@
+#include "shadow_amortized.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "shadow_brute_force.h"
+
+#include <cmath>
+
+b8 ShadowAmortized::create(VulkanDevice *device, u32 frame_count, u32 slices,
+                           f32 frame_budget_ms, f32 blend) {
+  fixed_slice_count = slices;
+  budget_ms = frame_budget_ms;
+  history_blend = blend;
+
+  if (fixed_slice_count > 0) {
+    slice_count = fixed_slice_count;
+    return true;
+  }
+
+  if (!device->properties.limits.timestampComputeAndGraphics) {
+    slice_count = SHADOW_AMORTIZED_DEFAULT_SLICES;
+    INFO("Amortized shadowing: no timestamps, using %u slices", slice_count);
+    return true;
+  }
+
+  if (!query_pool.create(device, VK_QUERY_TYPE_TIMESTAMP, 2 * frame_count)) {
+    ERROR("Failed to create a shadow timing query pool!");
+    return false;
+  }
+
+  timed = true;
+  timestamp_period_ms = device->properties.limits.timestampPeriod / 1.0e6;
+  query_slice_counts.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowAmortized::destroy(VulkanDevice *device,
+                              VulkanMemoryAllocator *allocator) {
+  if (timed) {
+    query_pool.destroy(device);
+  }
+  if (capacity > 0) {
+    history_buffer.destroy(allocator);
+  }
+}
+
+b8 ShadowAmortized::prepare(VulkanDevice *device,
+                            VulkanMemoryAllocator *allocator, u32 frame_index,
+                            u32 particle_count) {
+  if (timed && query_slice_counts[frame_index] > 0) {
+    u64 timestamps[2];
+    if (query_pool.results(device, 2 * frame_index, 2, timestamps)) {
+      f64 full_solve_ms = (timestamps[1] - timestamps[0]) *
+                          timestamp_period_ms *
+                          query_slice_counts[frame_index];
+
+      /* only takes effect once the current round is complete */
+      u32 slices = (u32)ceil(full_solve_ms / budget_ms);
+      if (slices < 1) {
+        slices = 1;
+      }
+      if (slices > SHADOW_AMORTIZED_MAX_SLICES) {
+        slices = SHADOW_AMORTIZED_MAX_SLICES;
+      }
+      if (slice_index == 0 && slices != slice_count) {
+        DEBUG("Amortized shadowing: %.3f ms per solve, %u slices",
+              full_solve_ms, slices);
+        slice_count = slices;
+      }
+    }
+    query_slice_counts[frame_index] = 0;
+  }
+
+  if (particle_count <= capacity) {
+    return true;
+  }
+
+  /* the other frames in flight may still be reading the old history */
+  device->waitIdle();
+
+  u32 new_capacity = capacity * 2;
+  if (new_capacity < particle_count) {
+    new_capacity = particle_count;
+  }
+
+  if (capacity > 0) {
+    history_buffer.destroy(allocator);
+    capacity = 0;
+  }
+
+  if (!history_buffer.create(allocator, sizeof(f32) * new_capacity,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a shadow history buffer!");
+    return false;
+  }
+  capacity = new_capacity;
+
+  /* same layout as FrameResources::compute_writeonly_descriptor_set */
+  VkDescriptorBufferInfo history_buffer_info =
+      vulkanDescriptorBufferInfo(&history_buffer);
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  builder.bufferBind(0, &history_buffer_info,
+                     VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                     VK_SHADER_STAGE_COMPUTE_BIT);
+  if (!builder.end(device, &history_descriptor_set)) {
+    ERROR("Failed to build a shadow history descriptor set!");
+    return false;
+  }
+
+  invalidate();
+
+  return true;
+}
+
+void ShadowAmortized::record(VulkanCommandBuffer *command_buffer,
+                             ShadowBruteForce *brute_force,
+                             FrameResources *frame, u32 frame_index,
+                             u32 particle_count, glm::vec4 sun_dir) {
+  if (!history_valid || particle_count != history_count ||
+      sun_dir != history_sun_dir) {
+    /* nothing to keep yet, shades every receiver once */
+    history_valid = false;
+    slice_index = 0;
+  }
+
+  /* never more slices than receivers */
+  u32 slices = history_valid ? slice_count : 1;
+  if (slices > particle_count) {
+    slices = particle_count;
+  }
+  if (slice_index >= slices) {
+    slice_index = 0;
+  }
+
+  /* the previous frame may still be shading into or copying out of the
+   * history */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  if (timed) {
+    command_buffer->queryPoolReset(&query_pool, 2 * frame_index, 2);
+    command_buffer->timestampWrite(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                   &query_pool, 2 * frame_index);
+  }
+
+  brute_force->recordSlice(command_buffer, frame, history_descriptor_set,
+                           particle_count, sun_dir, slices, slice_index,
+                           history_valid ? history_blend : 0.0f);
+
+  if (timed) {
+    command_buffer->timestampWrite(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                   &query_pool, 2 * frame_index + 1);
+    query_slice_counts[frame_index] = slices;
+  }
+
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+  command_buffer->bufferCopy(&history_buffer, &frame->shadows_buffer,
+                             sizeof(f32) * particle_count);
+
+  slice_index = (slice_index + 1) % slices;
+  history_valid = true;
+  history_count = particle_count;
+  history_sun_dir = sun_dir;
+}
+
+void ShadowAmortized::invalidate() { history_valid = false; }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_query_pool.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct ShadowBruteForce;
+struct VulkanCommandBuffer;
+
+#define SHADOW_AMORTIZED_MAX_SLICES 16
+/* used when the slice count should adapt but the device cannot time it */
+#define SHADOW_AMORTIZED_DEFAULT_SLICES 4
+#define SHADOW_AMORTIZED_DEFAULT_BUDGET_MS 2.0f
+
+/* particle_shadowing.comp spread over several frames: every frame shades one
+ * slice of the receivers, in round-robin order, into a history buffer kept
+ * across frames, which is then copied to the frame's shadows buffer. The
+ * other receivers keep their last value. The slice count is either fixed or
+ * picked at the start of every round so that a full solve, as timed with GPU
+ * timestamps, costs at most budget_ms per frame */
+struct ShadowAmortized {
+  VulkanBuffer history_buffer;
+  VkDescriptorSet history_descriptor_set;
+  u32 capacity = 0;
+  /* 0 adapts the slice count to budget_ms */
+  u32 fixed_slice_count;
+  f32 budget_ms;
+  /* weight of the previous value in [0, 1), 0 replaces it */
+  f32 history_blend;
+  u32 slice_count = 1;
+  u32 slice_index = 0;
+  /* the history only holds shadows of the same particles and light */
+  b8 history_valid = false;
+  u32 history_count = 0;
+  glm::vec4 history_sun_dir;
+
+  /* a pair of timestamps around the slice per frame in flight */
+  b8 timed = false;
+  VulkanQueryPool query_pool;
+  f64 timestamp_period_ms;
+  /* slice count of the pending queries of every frame, 0 when none */
+  std::vector<u32> query_slice_counts;
+
+  b8 create(VulkanDevice *device, u32 frame_count, u32 slices,
+            f32 frame_budget_ms, f32 blend);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the history waits for the device to go idle */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             u32 frame_index, u32 particle_count);
+
+  void record(VulkanCommandBuffer *command_buffer,
+              ShadowBruteForce *brute_force, FrameResources *frame,
+              u32 frame_index, u32 particle_count, glm::vec4 sun_dir);
+
+  /* forces a full solve on the next record */
+  void invalidate();
+};
\ No newline at end of file
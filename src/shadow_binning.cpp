@@ -0,0 +1,228 @@
+#include "shadow_binning.h"
+
+#include "core/logger.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "shadow_grid.h"
+
+#define BINNING_BINDING_COUNT 6
+
+b8 ShadowBinning::create(VulkanDevice *device,
+                         VulkanMemoryAllocator *allocator, u32 frame_count) {
+  grid_size = SHADOW_GRID_SIZE;
+  grid_bounds = glm::vec4(-SHADOW_GRID_EXTENT, -SHADOW_GRID_EXTENT,
+                          SHADOW_GRID_EXTENT, SHADOW_GRID_EXTENT);
+
+  /* binding 0: particles, binding 1: shadows, binding 2: cell counts,
+   * binding 3: cell offsets, binding 4: particle cells, binding 5: binned
+   * particles */
+  VkDescriptorSetLayoutBinding bindings[BINNING_BINDING_COUNT];
+  for (u32 i = 0; i < BINNING_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = BINNING_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsBinning);
+
+  const char *shader_paths[4] = {
+      "assets/shaders/particle_binning_count.comp.spv",
+      "assets/shaders/particle_binning_scan.comp.spv",
+      "assets/shaders/particle_binning_scatter.comp.spv",
+      "assets/shaders/particle_shadowing_binned.comp.spv"};
+  VulkanPipeline *pipelines[4] = {&count_pipeline, &scan_pipeline,
+                                  &scatter_pipeline, &shadowing_pipeline};
+  for (u32 i = 0; i < 4; ++i) {
+    if (!pipelines[i]->createComputeFromFile(device, 1, &descriptor_set_layout,
+                                             1, &push_constant_range,
+                                             shader_paths[i])) {
+      ERROR("Failed to create a binning pipeline!");
+      return false;
+    }
+  }
+
+  if (!cell_counts_buffer.create(allocator,
+                                 sizeof(u32) * grid_size * grid_size,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a cell counts buffer!");
+    return false;
+  }
+  if (!cell_offsets_buffer.create(allocator,
+                                  sizeof(u32) * grid_size * grid_size,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a cell offsets buffer!");
+    return false;
+  }
+
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowBinning::destroy(VulkanDevice *device,
+                            VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    destroyBuffers(allocator);
+  }
+
+  cell_offsets_buffer.destroy(allocator);
+  cell_counts_buffer.destroy(allocator);
+
+  shadowing_pipeline.destroy(device);
+  scatter_pipeline.destroy(device);
+  scan_pipeline.destroy(device);
+  count_pipeline.destroy(device);
+}
+
+b8 ShadowBinning::createBuffers(VulkanMemoryAllocator *allocator,
+                                u32 particle_capacity) {
+  capacity = particle_capacity;
+
+  if (!particle_cells_buffer.create(allocator, sizeof(glm::uvec2) * capacity,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a particle cells buffer!");
+    return false;
+  }
+  if (!binned_buffer.create(allocator, sizeof(glm::vec4) * capacity,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a binned particles buffer!");
+    return false;
+  }
+
+  return true;
+}
+
+void ShadowBinning::destroyBuffers(VulkanMemoryAllocator *allocator) {
+  binned_buffer.destroy(allocator);
+  particle_cells_buffer.destroy(allocator);
+  capacity = 0;
+}
+
+b8 ShadowBinning::prepare(VulkanDevice *device,
+                          VulkanMemoryAllocator *allocator,
+                          std::vector<FrameResources> &frames,
+                          u32 frame_index, u32 particle_count) {
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be binning into the old buffers */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      destroyBuffers(allocator);
+    }
+    if (!createBuffers(allocator, new_capacity)) {
+      return false;
+    }
+
+    descriptor_set_generations.assign(frames.size(), 0);
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[BINNING_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer),
+      vulkanDescriptorBufferInfo(&cell_counts_buffer),
+      vulkanDescriptorBufferInfo(&cell_offsets_buffer),
+      vulkanDescriptorBufferInfo(&particle_cells_buffer),
+      vulkanDescriptorBufferInfo(&binned_buffer),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < BINNING_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build a binning descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+void ShadowBinning::record(VulkanCommandBuffer *command_buffer,
+                           u32 frame_index, u32 particle_count,
+                           glm::vec4 sun_dir) {
+  PushConstantsBinning push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.grid_bounds = grid_bounds;
+  push_constants.particle_count = particle_count;
+  push_constants.grid_size = grid_size;
+  push_constants.max_radius = PARTICLE_MAX_RADIUS;
+
+  u32 group_count =
+      (particle_count + BINNING_GROUP_SIZE - 1) / BINNING_GROUP_SIZE;
+
+  /* the previous frame may still be reading the shared binning buffers */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT);
+  command_buffer->bufferFill(&cell_counts_buffer, 0);
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  VulkanPipeline *pipelines[4] = {&count_pipeline, &scan_pipeline,
+                                  &scatter_pipeline, &shadowing_pipeline};
+  /* the scan runs as a single workgroup over the whole grid */
+  u32 group_counts[4] = {group_count, 1, group_count, group_count};
+
+  for (u32 i = 0; i < 4; ++i) {
+    if (i > 0) {
+      command_buffer->memoryBarrier(
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+    command_buffer->descriptorSetBind(pipelines[i],
+                                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      descriptor_sets[frame_index], 0, 0, 0);
+    command_buffer->pushConstants(pipelines[i], VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                  sizeof(PushConstantsBinning),
+                                  &push_constants);
+    command_buffer->dispatch(group_counts[i], 1);
+  }
+}
\ No newline at end of file
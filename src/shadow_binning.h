@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define BINNING_GROUP_SIZE 256
+
+struct PushConstantsBinning {
+  glm::vec4 sun_dir;
+  glm::vec4 grid_bounds;
+  u32 particle_count;
+  u32 grid_size;
+  f32 max_radius;
+};
+
+/* GPU counterpart of ShadowGrid: particles are binned into a uniform grid in
+ * light space (count, scan, scatter) so that particle_shadowing_binned.comp
+ * only tests the occluders in the cells a receiver can overlap instead of all
+ * of them. The binning buffers are shared by the frames in flight, record
+ * orders the passes of consecutive frames with barriers */
+struct ShadowBinning {
+  VulkanPipeline count_pipeline;
+  VulkanPipeline scan_pipeline;
+  VulkanPipeline scatter_pipeline;
+  VulkanPipeline shadowing_pipeline;
+  VulkanBuffer cell_counts_buffer;
+  VulkanBuffer cell_offsets_buffer;
+  VulkanBuffer particle_cells_buffer;
+  VulkanBuffer binned_buffer;
+  u32 capacity = 0;
+  u32 grid_size;
+  glm::vec4 grid_bounds;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the shared buffers waits for the device to go idle */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec4 sun_dir);
+
+  b8 createBuffers(VulkanMemoryAllocator *allocator, u32 particle_capacity);
+  void destroyBuffers(VulkanMemoryAllocator *allocator);
+};
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include "shadow_brute_force.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_command_pool.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "renderer/vulkan/vulkan_queue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define SHADOW_TUNING_CONSTANT_GROUP_SIZE 0
+#define SHADOW_TUNING_CONSTANT_TILE_SIZE 1
+
+static void shadowDispatch(VulkanCommandBuffer *command_buffer,
+                           VulkanPipeline *pipeline, u32 group_size,
+                           FrameResources *frame,
+                           VkDescriptorSet shadows_descriptor_set,
+                           PushConstantsCompute push_constants) {
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    frame->compute_readonly_descriptor_set, 0,
+                                    0, 0);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    shadows_descriptor_set, 1, 0, 0);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    frame->light_ubo_descriptor_set, 2, 0, 0);
+
+  command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsCompute), &push_constants);
+
+  /* receivers of the slice, the first ones of the range have one more */
+  u32 receiver_count =
+      (push_constants.particle_count - push_constants.slice_index +
+       push_constants.slice_count - 1) /
+      push_constants.slice_count;
+  command_buffer->dispatch((receiver_count + group_size - 1) / group_size, 1);
+}
+
+VulkanSpecialization shadowTuningSpecialization(ShadowTuning shadow_tuning) {
+  VulkanSpecialization specialization;
+  specialization.constantSet(SHADOW_TUNING_CONSTANT_GROUP_SIZE,
+                             shadow_tuning.group_size);
+  specialization.constantSet(SHADOW_TUNING_CONSTANT_TILE_SIZE,
+                             shadow_tuning.tile_size);
+
+  return specialization;
+}
+
+static b8 tuningFits(const VkPhysicalDeviceLimits &limits,
+                      ShadowTuning shadow_tuning) {
+  return shadow_tuning.group_size > 0 &&
+         shadow_tuning.group_size <= limits.maxComputeWorkGroupSize[0] &&
+         shadow_tuning.group_size <= limits.maxComputeWorkGroupInvocations &&
+         shadow_tuning.tile_size % shadow_tuning.group_size == 0 &&
+         shadow_tuning.tile_size * sizeof(glm::vec4) <=
+             limits.maxComputeSharedMemorySize;
+}
+
+static PushConstantsCompute shadowPushConstants(u32 particle_count,
+                                                glm::vec4 sun_dir) {
+  PushConstantsCompute push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.particle_count = particle_count;
+
+  return push_constants;
+}
+
+b8 ShadowBruteForce::create(VulkanDevice *device) {
+  /* set 0: particles, set 1: shadows, set 2: light UBO */
+  for (u32 i = 0; i < SHADOW_DESCRIPTOR_SET_COUNT; ++i) {
+    VkDescriptorSetLayoutBinding descriptor_set_layout_binding =
+        vulkanDescriptorSetLayoutBinding(
+            0,
+            i < 2 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                  : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_SHADER_STAGE_COMPUTE_BIT);
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+    descriptor_set_layout_create_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptor_set_layout_create_info.pNext = 0;
+    descriptor_set_layout_create_info.flags = 0;
+    descriptor_set_layout_create_info.bindingCount = 1;
+    descriptor_set_layout_create_info.pBindings =
+        &descriptor_set_layout_binding;
+
+    descriptor_set_layouts[i] = VulkanDescriptorSetLayoutCache::layoutCreate(
+        device, &descriptor_set_layout_create_info);
+  }
+
+  tuned = tuningLoad(device, SHADOW_TUNING_CACHE_PATH);
+
+  if (!pipelineCreate(device, tuning, &pipeline)) {
+    ERROR("Failed to create a shadowing pipeline!");
+    return false;
+  }
+
+  if (device->properties.apiVersion < VK_API_VERSION_1_2 ||
+      !device->subgroupSupports(VK_SHADER_STAGE_COMPUTE_BIT,
+                                VK_SUBGROUP_FEATURE_BASIC_BIT |
+                                    VK_SUBGROUP_FEATURE_BALLOT_BIT)) {
+    INFO("Subgroup shadowing unsupported, using shared memory tiles");
+    return true;
+  }
+
+  const VkPhysicalDeviceLimits &limits = device->properties.limits;
+  u32 subgroup_size = device->subgroup.subgroupSize;
+  u32 group_size = (SHADOW_SUBGROUP_GROUP_SIZE + subgroup_size - 1) /
+                   subgroup_size * subgroup_size;
+  if (group_size > limits.maxComputeWorkGroupSize[0] ||
+      group_size > limits.maxComputeWorkGroupInvocations) {
+    group_size = subgroup_size;
+  }
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsCompute);
+
+  VulkanSpecialization specialization;
+  specialization.constantSet(SHADOW_TUNING_CONSTANT_GROUP_SIZE, group_size);
+  VkSpecializationInfo specialization_info = specialization.getInfo();
+
+  /* the tiled pipeline still works, so this is not fatal */
+  if (!subgroup_pipeline.createComputeFromFile(
+          device, SHADOW_DESCRIPTOR_SET_COUNT, descriptor_set_layouts, 1,
+          &push_constant_range,
+          "assets/shaders/particle_shadowing_subgroup.comp.spv",
+          &specialization_info)) {
+    WARN("Failed to create the subgroup shadowing pipeline!");
+    return true;
+  }
+
+  subgroup_group_size = group_size;
+  INFO("Subgroup shadowing: subgroup size %u, group %u", subgroup_size,
+       subgroup_group_size);
+
+  return true;
+}
+
+void ShadowBruteForce::destroy(VulkanDevice *device) {
+  if (subgroup_group_size) {
+    subgroup_pipeline.destroy(device);
+  }
+  pipeline.destroy(device);
+}
+
+void ShadowBruteForce::record(VulkanCommandBuffer *command_buffer,
+                              FrameResources *frame, u32 particle_count,
+                              glm::vec4 sun_dir) {
+  shadowDispatch(command_buffer, &pipeline, tuning.group_size, frame,
+                 frame->compute_writeonly_descriptor_set,
+                 shadowPushConstants(particle_count, sun_dir));
+}
+
+void ShadowBruteForce::recordSlice(VulkanCommandBuffer *command_buffer,
+                                   FrameResources *frame,
+                                   VkDescriptorSet shadows_descriptor_set,
+                                   u32 particle_count, glm::vec4 sun_dir,
+                                   u32 slice_count, u32 slice_index,
+                                   f32 history_blend) {
+  PushConstantsCompute push_constants =
+      shadowPushConstants(particle_count, sun_dir);
+  push_constants.slice_count = slice_count;
+  push_constants.slice_index = slice_index;
+  push_constants.history_blend = history_blend;
+
+  shadowDispatch(command_buffer, &pipeline, tuning.group_size, frame,
+                 shadows_descriptor_set, push_constants);
+}
+
+void ShadowBruteForce::recordSubgroup(VulkanCommandBuffer *command_buffer,
+                                      FrameResources *frame,
+                                      u32 particle_count, glm::vec4 sun_dir) {
+  if (!subgroup_group_size) {
+    record(command_buffer, frame, particle_count, sun_dir);
+    return;
+  }
+
+  shadowDispatch(command_buffer, &subgroup_pipeline, subgroup_group_size,
+                 frame, frame->compute_writeonly_descriptor_set,
+                 shadowPushConstants(particle_count, sun_dir));
+}
+
+b8 ShadowBruteForce::pipelineCreate(VulkanDevice *device,
+                                    ShadowTuning shadow_tuning,
+                                    VulkanPipeline *out_pipeline) {
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsCompute);
+
+  VulkanSpecialization specialization =
+      shadowTuningSpecialization(shadow_tuning);
+  VkSpecializationInfo specialization_info = specialization.getInfo();
+
+  return out_pipeline->createComputeFromFile(
+      device, SHADOW_DESCRIPTOR_SET_COUNT, descriptor_set_layouts, 1,
+      &push_constant_range, "assets/shaders/particle_shadowing.comp.spv",
+      &specialization_info);
+}
+
+b8 ShadowBruteForce::autotune(VulkanDevice *device,
+                              VulkanMemoryAllocator *allocator,
+                              VulkanQueue *queue,
+                              VulkanCommandPool *command_pool,
+                              FrameResources *frame,
+                              const Particle *particles, u32 particle_count,
+                              glm::vec4 sun_dir) {
+  u32 workload = particle_count;
+  if (workload < SHADOW_TUNING_MIN_PARTICLES) {
+    workload = SHADOW_TUNING_MIN_PARTICLES;
+  }
+  if (workload > SHADOW_TUNING_MAX_PARTICLES) {
+    workload = SHADOW_TUNING_MAX_PARTICLES;
+  }
+
+  device->waitIdle();
+  if (!frame->reserve(device, allocator, workload)) {
+    ERROR("Failed to grow particle buffers for tuning!");
+    return false;
+  }
+
+  Particle *mapped = (Particle *)frame->particles_buffer.mapped;
+  for (u32 i = 0; i < workload; i += particle_count) {
+    u32 count = workload - i < particle_count ? workload - i : particle_count;
+    memcpy(mapped + i, particles, sizeof(Particle) * count);
+  }
+  frame->particles_buffer.flush(allocator, 0, sizeof(Particle) * workload);
+
+  const VkPhysicalDeviceLimits &limits = device->properties.limits;
+  u32 max_group_size = limits.maxComputeWorkGroupSize[0];
+  if (max_group_size > limits.maxComputeWorkGroupInvocations) {
+    max_group_size = limits.maxComputeWorkGroupInvocations;
+  }
+
+  ShadowTuning best_tuning = tuning;
+  f64 best_time = -1.0;
+
+  for (u32 group_size = 32; group_size <= max_group_size; group_size *= 2) {
+    for (u32 tile_factor = 1; tile_factor <= 8; tile_factor *= 2) {
+      ShadowTuning candidate;
+      candidate.group_size = group_size;
+      candidate.tile_size = group_size * tile_factor;
+      if (!tuningFits(limits, candidate)) {
+        break;
+      }
+
+      VulkanPipeline candidate_pipeline;
+      if (!pipelineCreate(device, candidate, &candidate_pipeline)) {
+        continue;
+      }
+
+      /* the first run warms up caches and lazily compiled pipelines */
+      f64 candidate_time = -1.0;
+      for (u32 run = 0; run <= SHADOW_TUNING_RUNS; ++run) {
+        VulkanCommandBuffer command_buffer;
+        if (!command_buffer.allocateAndBeginSingleUse(device, command_pool)) {
+          candidate_pipeline.destroy(device);
+          return false;
+        }
+
+        shadowDispatch(&command_buffer, &candidate_pipeline,
+                       candidate.group_size, frame,
+                       frame->compute_writeonly_descriptor_set,
+                       shadowPushConstants(workload, sun_dir));
+
+        auto start = std::chrono::steady_clock::now();
+        command_buffer.endAndFreeSingleUse(device, command_pool, queue);
+        std::chrono::duration<f64, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        if (run > 0 && (candidate_time < 0.0 ||
+                        elapsed.count() < candidate_time)) {
+          candidate_time = elapsed.count();
+        }
+      }
+
+      candidate_pipeline.destroy(device);
+
+      DEBUG("Shadow tuning: group %u, tile %u: %.3f ms", candidate.group_size,
+            candidate.tile_size, candidate_time);
+
+      if (best_time < 0.0 || candidate_time < best_time) {
+        best_time = candidate_time;
+        best_tuning = candidate;
+      }
+    }
+  }
+
+  VulkanPipeline best_pipeline;
+  if (!pipelineCreate(device, best_tuning, &best_pipeline)) {
+    ERROR("Failed to create the tuned shadowing pipeline!");
+    return false;
+  }
+
+  pipeline.destroy(device);
+  pipeline = best_pipeline;
+  tuning = best_tuning;
+
+  INFO("Shadow tuning: group %u, tile %u (%.3f ms for %u particles)",
+       tuning.group_size, tuning.tile_size, best_time, workload);
+
+  /* a read-only working directory only costs a retune on the next start */
+  tuningSave(device, SHADOW_TUNING_CACHE_PATH);
+  tuned = true;
+
+  return true;
+}
+
+b8 ShadowBruteForce::tuningLoad(VulkanDevice *device, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  const VkPhysicalDeviceProperties &properties = device->properties;
+
+  b8 found = false;
+  ShadowTuning loaded;
+  u32 vendor_id, device_id, driver_version, group_size, tile_size;
+  while (fscanf(file, "%u %u %u %u %u", &vendor_id, &device_id,
+                &driver_version, &group_size, &tile_size) == 5) {
+    if (vendor_id == properties.vendorID &&
+        device_id == properties.deviceID &&
+        driver_version == properties.driverVersion) {
+      loaded.group_size = group_size;
+      loaded.tile_size = tile_size;
+      found = true;
+    }
+  }
+
+  fclose(file);
+
+  /* a hand edited or corrupted cache must not fail pipeline creation */
+  if (found && !tuningFits(properties.limits, loaded)) {
+    WARN("Shadow tuning in '%s' exceeds the device limits: group %u, tile %u",
+         path, loaded.group_size, loaded.tile_size);
+    return false;
+  }
+  if (found) {
+    tuning = loaded;
+  }
+
+  if (found) {
+    INFO("Shadow tuning loaded from '%s': group %u, tile %u", path,
+         tuning.group_size, tuning.tile_size);
+  }
+
+  return found;
+}
+
+b8 ShadowBruteForce::tuningSave(VulkanDevice *device, const char *path) {
+  const VkPhysicalDeviceProperties &properties = device->properties;
+
+  /* keep the entries of other devices */
+  std::vector<std::string> lines;
+  FILE *file = fopen(path, "r");
+  if (file) {
+    u32 vendor_id, device_id, driver_version, group_size, tile_size;
+    while (fscanf(file, "%u %u %u %u %u", &vendor_id, &device_id,
+                  &driver_version, &group_size, &tile_size) == 5) {
+      if (vendor_id == properties.vendorID &&
+          device_id == properties.deviceID &&
+          driver_version == properties.driverVersion) {
+        continue;
+      }
+
+      char line[128];
+      snprintf(line, sizeof(line), "%u %u %u %u %u\n", vendor_id, device_id,
+               driver_version, group_size, tile_size);
+      lines.emplace_back(line);
+    }
+    fclose(file);
+  }
+
+  file = fopen(path, "w");
+  if (!file) {
+    ERROR("Failed to write shadow tuning to '%s'!", path);
+    return false;
+  }
+
+  for (u32 i = 0; i < lines.size(); ++i) {
+    fputs(lines[i].c_str(), file);
+  }
+  fprintf(file, "%u %u %u %u %u\n", properties.vendorID, properties.deviceID,
+          properties.driverVersion, tuning.group_size, tuning.tile_size);
+
+  fclose(file);
+
+  return true;
+}
\ No newline at end of file
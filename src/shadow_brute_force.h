@@ -0,0 +1,97 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+struct VulkanCommandPool;
+struct VulkanQueue;
+
+#define SHADOW_TUNING_CACHE_PATH "shadow_tuning.cache"
+/* small particle counts time mostly submission overhead */
+#define SHADOW_TUNING_MIN_PARTICLES 16384
+/* every candidate is an O(N^2) dispatch, large scenes are tuned on a subset
+ * to keep startup short and each dispatch well below the driver timeout */
+#define SHADOW_TUNING_MAX_PARTICLES 65536
+#define SHADOW_TUNING_RUNS 3
+/* rounded up to a multiple of the device subgroup size */
+#define SHADOW_SUBGROUP_GROUP_SIZE 256
+/* particles, shadows and the frame's LightUBO */
+#define SHADOW_DESCRIPTOR_SET_COUNT 3
+
+/* the slice fields are only read by particle_shadowing.comp, see
+ * ShadowAmortized */
+struct PushConstantsCompute {
+  glm::vec4 sun_dir;
+  u32 particle_count;
+  u32 slice_count = 1;
+  u32 slice_index = 0;
+  f32 history_blend = 0.0f;
+};
+
+/* specialization constants of particle_shadowing.comp */
+struct ShadowTuning {
+  u32 group_size = 256;
+  u32 tile_size = 256;
+};
+
+/* the workgroup and tile size constants of particle_shadowing.comp, shared
+ * by the kernels that copy its tiled loop */
+VulkanSpecialization shadowTuningSpecialization(ShadowTuning shadow_tuning);
+
+/* the all-pairs shadow pass, particle_shadowing.comp. Its workgroup and tile
+ * sizes are specialization constants picked per device by autotune and
+ * cached on disk, keyed by vendor, device and driver version. The light
+ * matrix comes from the frame's LightUBO, which has to be written before
+ * recording.
+ *
+ * particle_shadowing_subgroup.comp is the same pass with the occluders
+ * broadcast across subgroups instead of staged in shared memory. It needs
+ * compute subgroup ballot support and a Vulkan 1.2 device */
+struct ShadowBruteForce {
+  VulkanPipeline pipeline;
+  VkDescriptorSetLayout descriptor_set_layouts[SHADOW_DESCRIPTOR_SET_COUNT];
+  ShadowTuning tuning;
+  /* false until a cached or measured tuning is in use */
+  b8 tuned = false;
+  VulkanPipeline subgroup_pipeline;
+  /* 0 when the device cannot run the subgroup variant */
+  u32 subgroup_group_size = 0;
+
+  b8 create(VulkanDevice *device);
+  void destroy(VulkanDevice *device);
+
+  void record(VulkanCommandBuffer *command_buffer, FrameResources *frame,
+              u32 particle_count, glm::vec4 sun_dir);
+  /* shades receivers slice_index, slice_index + slice_count, ... into the
+   * buffer behind shadows_descriptor_set, blending with what it holds */
+  void recordSlice(VulkanCommandBuffer *command_buffer, FrameResources *frame,
+                   VkDescriptorSet shadows_descriptor_set, u32 particle_count,
+                   glm::vec4 sun_dir, u32 slice_count, u32 slice_index,
+                   f32 history_blend);
+  /* falls back to record without subgroup support */
+  void recordSubgroup(VulkanCommandBuffer *command_buffer,
+                      FrameResources *frame, u32 particle_count,
+                      glm::vec4 sun_dir);
+
+  /* times every candidate the device limits allow, with the particles tiled
+   * up to SHADOW_TUNING_MIN_PARTICLES or cut down to
+   * SHADOW_TUNING_MAX_PARTICLES, and keeps the fastest pipeline. The frame's
+   * particles buffer must be host mapped */
+  b8 autotune(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+              VulkanQueue *queue, VulkanCommandPool *command_pool,
+              FrameResources *frame, const Particle *particles,
+              u32 particle_count, glm::vec4 sun_dir);
+
+  /* ignores an entry the device limits no longer allow */
+  b8 tuningLoad(VulkanDevice *device, const char *path);
+  b8 tuningSave(VulkanDevice *device, const char *path);
+
+  b8 pipelineCreate(VulkanDevice *device, ShadowTuning shadow_tuning,
+                    VulkanPipeline *out_pipeline);
+};
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "shadow_depth_sort.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "shadow_grid.h"
+
+#define DEPTH_SORT_BINDING_COUNT 8
+
+b8 ShadowDepthSort::create(VulkanDevice *device, u32 frame_count) {
+  /* binding 0: particles, binding 1: shadows, binding 2/3: keys/values in,
+   * binding 4/5: keys/values out, binding 6: histogram, binding 7: light
+   * space particle data */
+  VkDescriptorSetLayoutBinding bindings[DEPTH_SORT_BINDING_COUNT];
+  for (u32 i = 0; i < DEPTH_SORT_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = DEPTH_SORT_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsDepthSort);
+
+  const char *shader_paths[5] = {
+      "assets/shaders/particle_depth_keys.comp.spv",
+      "assets/shaders/radix_sort_histogram.comp.spv",
+      "assets/shaders/radix_sort_scan.comp.spv",
+      "assets/shaders/radix_sort_scatter.comp.spv",
+      "assets/shaders/particle_shadowing_sorted.comp.spv"};
+  VulkanPipeline *pipelines[5] = {&keys_pipeline, &histogram_pipeline,
+                                  &scan_pipeline, &scatter_pipeline,
+                                  &shadowing_pipeline};
+  for (u32 i = 0; i < 5; ++i) {
+    if (!pipelines[i]->createComputeFromFile(device, 1, &descriptor_set_layout,
+                                             1, &push_constant_range,
+                                             shader_paths[i])) {
+      ERROR("Failed to create a depth sort pipeline!");
+      return false;
+    }
+  }
+
+  descriptor_sets[0].resize(frame_count);
+  descriptor_sets[1].resize(frame_count);
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowDepthSort::destroy(VulkanDevice *device,
+                              VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    destroyBuffers(allocator);
+  }
+
+  shadowing_pipeline.destroy(device);
+  scatter_pipeline.destroy(device);
+  scan_pipeline.destroy(device);
+  histogram_pipeline.destroy(device);
+  keys_pipeline.destroy(device);
+}
+
+b8 ShadowDepthSort::createBuffers(VulkanMemoryAllocator *allocator,
+                                  u32 particle_capacity) {
+  capacity = particle_capacity;
+
+  for (u32 i = 0; i < 2; ++i) {
+    if (!keys_buffers[i].create(allocator, sizeof(u32) * capacity,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                VMA_MEMORY_USAGE_GPU_ONLY) ||
+        !values_buffers[i].create(allocator, sizeof(u32) * capacity,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY)) {
+      ERROR("Failed to create sort buffers!");
+      return false;
+    }
+  }
+
+  u32 group_count = (capacity + SORT_GROUP_SIZE - 1) / SORT_GROUP_SIZE;
+  if (!histogram_buffer.create(
+          allocator, sizeof(u32) * (1 << SORT_RADIX_BITS) * group_count,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a histogram buffer!");
+    return false;
+  }
+  if (!light_data_buffer.create(allocator, sizeof(glm::vec4) * capacity,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a light data buffer!");
+    return false;
+  }
+
+  return true;
+}
+
+void ShadowDepthSort::destroyBuffers(VulkanMemoryAllocator *allocator) {
+  light_data_buffer.destroy(allocator);
+  histogram_buffer.destroy(allocator);
+  for (u32 i = 0; i < 2; ++i) {
+    values_buffers[i].destroy(allocator);
+    keys_buffers[i].destroy(allocator);
+  }
+  capacity = 0;
+}
+
+b8 ShadowDepthSort::prepare(VulkanDevice *device,
+                            VulkanMemoryAllocator *allocator,
+                            std::vector<FrameResources> &frames,
+                            u32 frame_index, u32 particle_count) {
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be sorting in the old buffers */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      destroyBuffers(allocator);
+    }
+    if (!createBuffers(allocator, new_capacity)) {
+      return false;
+    }
+
+    descriptor_set_generations.assign(frames.size(), 0);
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo particles_buffer_info =
+      vulkanDescriptorBufferInfo(&frame.particles_buffer);
+  VkDescriptorBufferInfo shadows_buffer_info =
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer);
+  VkDescriptorBufferInfo histogram_buffer_info =
+      vulkanDescriptorBufferInfo(&histogram_buffer);
+  VkDescriptorBufferInfo light_data_buffer_info =
+      vulkanDescriptorBufferInfo(&light_data_buffer);
+
+  for (u32 i = 0; i < 2; ++i) {
+    VkDescriptorBufferInfo keys_in_info =
+        vulkanDescriptorBufferInfo(&keys_buffers[i]);
+    VkDescriptorBufferInfo values_in_info =
+        vulkanDescriptorBufferInfo(&values_buffers[i]);
+    VkDescriptorBufferInfo keys_out_info =
+        vulkanDescriptorBufferInfo(&keys_buffers[1 - i]);
+    VkDescriptorBufferInfo values_out_info =
+        vulkanDescriptorBufferInfo(&values_buffers[1 - i]);
+
+    VkDescriptorBufferInfo *buffer_infos[DEPTH_SORT_BINDING_COUNT] = {
+        &particles_buffer_info, &shadows_buffer_info,
+        &keys_in_info,          &values_in_info,
+        &keys_out_info,         &values_out_info,
+        &histogram_buffer_info, &light_data_buffer_info};
+
+    VulkanDescriptorSetBuilder builder;
+    builder.begin();
+    for (u32 j = 0; j < DEPTH_SORT_BINDING_COUNT; ++j) {
+      builder.bufferBind(j, buffer_infos[j], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                         VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    if (!builder.end(device, &descriptor_sets[i][frame_index])) {
+      ERROR("Failed to build a depth sort descriptor set!");
+      return false;
+    }
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+static void depthSortDispatch(VulkanCommandBuffer *command_buffer,
+                              VulkanPipeline *pipeline,
+                              VkDescriptorSet descriptor_set,
+                              PushConstantsDepthSort *push_constants,
+                              u32 group_count) {
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  command_buffer->descriptorSetBind(pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_set, 0, 0, 0);
+  command_buffer->pushConstants(pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsDepthSort),
+                                push_constants);
+  command_buffer->dispatch(group_count, 1);
+}
+
+void ShadowDepthSort::record(VulkanCommandBuffer *command_buffer,
+                             u32 frame_index, u32 particle_count,
+                             glm::vec4 sun_dir) {
+  PushConstantsDepthSort push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.particle_count = particle_count;
+  push_constants.shift = 0;
+  push_constants.min_transmittance = SHADOW_MIN_TRANSMITTANCE;
+
+  u32 group_count = (particle_count + SORT_GROUP_SIZE - 1) / SORT_GROUP_SIZE;
+
+  /* keys are written into pair 0 so the first pass can read them from there,
+   * an even pass count brings the sorted order back to pair 0. The barrier
+   * in front of every dispatch also orders against the previous frame */
+  depthSortDispatch(command_buffer, &keys_pipeline,
+                    descriptor_sets[1][frame_index], &push_constants,
+                    group_count);
+
+  for (u32 pass = 0; pass < SORT_PASS_COUNT; ++pass) {
+    VkDescriptorSet descriptor_set = descriptor_sets[pass % 2][frame_index];
+    push_constants.shift = pass * SORT_RADIX_BITS;
+
+    depthSortDispatch(command_buffer, &histogram_pipeline, descriptor_set,
+                      &push_constants, group_count);
+    depthSortDispatch(command_buffer, &scan_pipeline, descriptor_set,
+                      &push_constants, 1);
+    depthSortDispatch(command_buffer, &scatter_pipeline, descriptor_set,
+                      &push_constants, group_count);
+  }
+
+  depthSortDispatch(command_buffer, &shadowing_pipeline,
+                    descriptor_sets[0][frame_index], &push_constants,
+                    group_count);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define SORT_GROUP_SIZE 256
+#define SORT_RADIX_BITS 8
+#define SORT_PASS_COUNT (32 / SORT_RADIX_BITS)
+
+struct PushConstantsDepthSort {
+  glm::vec4 sun_dir;
+  u32 particle_count;
+  u32 shift;
+  f32 min_transmittance;
+};
+
+/* depth-aware shadowing: particles are radix sorted by light-space depth on
+ * the GPU and each one only accumulates occlusion from the particles in front
+ * of it, front to back, until almost no light is left. Like ShadowBinning the
+ * sort buffers are shared by the frames in flight */
+struct ShadowDepthSort {
+  VulkanPipeline keys_pipeline;
+  VulkanPipeline histogram_pipeline;
+  VulkanPipeline scan_pipeline;
+  VulkanPipeline scatter_pipeline;
+  VulkanPipeline shadowing_pipeline;
+  /* ping-pong pairs, the sorted order ends up in index 0 */
+  VulkanBuffer keys_buffers[2];
+  VulkanBuffer values_buffers[2];
+  VulkanBuffer histogram_buffer;
+  VulkanBuffer light_data_buffer;
+  u32 capacity = 0;
+  /* per frame, set i reads pair i and writes the other one */
+  std::vector<VkDescriptorSet> descriptor_sets[2];
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the shared buffers waits for the device to go idle */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec4 sun_dir);
+
+  b8 createBuffers(VulkanMemoryAllocator *allocator, u32 particle_capacity);
+  void destroyBuffers(VulkanMemoryAllocator *allocator);
+};
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "shadow_grid.h"
+
+#include "core/job_system.h"
+#include "light_space.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define SHADOW_JOB_CHUNK_SIZE 256
+
+void ShadowGrid::create(u32 grid_size, glm::vec4 grid_bounds) {
+  size = grid_size;
+  bounds = grid_bounds;
+  cell_counts.resize(size * size);
+  cell_offsets.resize(size * size);
+}
+
+glm::ivec2 ShadowGrid::getCell(glm::vec2 position) {
+  glm::vec2 normalized =
+      glm::vec2((position.x - bounds.x) / (bounds.z - bounds.x),
+                (position.y - bounds.y) / (bounds.w - bounds.y));
+
+  i32 x = (i32)floorf(normalized.x * size);
+  i32 y = (i32)floorf(normalized.y * size);
+  x = x < 0 ? 0 : (x > (i32)size - 1 ? (i32)size - 1 : x);
+  y = y < 0 ? 0 : (y > (i32)size - 1 ? (i32)size - 1 : y);
+
+  return glm::ivec2(x, y);
+}
+
+void ShadowGrid::build(const Particle *particles, u32 count,
+                       const glm::mat4 &light_matrix) {
+  std::vector<glm::vec2> positions(count);
+  std::vector<u32> cells(count);
+
+  for (u32 i = 0; i < cell_counts.size(); ++i) {
+    cell_counts[i] = 0;
+  }
+
+  for (u32 i = 0; i < count; ++i) {
+    positions[i] = lightProject(light_matrix, particles[i].pos);
+    glm::ivec2 cell = getCell(positions[i]);
+    cells[i] = cell.y * size + cell.x;
+    cell_counts[cells[i]]++;
+  }
+
+  u32 offset = 0;
+  for (u32 i = 0; i < cell_counts.size(); ++i) {
+    cell_offsets[i] = offset;
+    offset += cell_counts[i];
+  }
+
+  std::vector<u32> cursors = cell_offsets;
+  binned.resize(count);
+  for (u32 i = 0; i < count; ++i) {
+    binned[cursors[cells[i]]++] = glm::vec4(
+        positions[i].x, positions[i].y, particles[i].radius, 0.0f);
+  }
+}
+
+void ShadowGrid::solve(const Particle *particles, u32 count,
+                       const glm::mat4 &light_matrix, f32 max_radius,
+                       f32 *out_shadows) {
+  JobSystem::parallelFor(
+      count, SHADOW_JOB_CHUNK_SIZE, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+          glm::vec2 position = lightProject(light_matrix, particles[i].pos);
+          f32 radius = particles[i].radius;
+          f32 reach = radius + max_radius;
+
+          glm::ivec2 min_cell =
+              getCell(glm::vec2(position.x - reach, position.y - reach));
+          glm::ivec2 max_cell =
+              getCell(glm::vec2(position.x + reach, position.y + reach));
+
+          f32 shadow = 0.0f;
+          for (i32 y = min_cell.y; y <= max_cell.y; ++y) {
+            for (i32 x = min_cell.x; x <= max_cell.x; ++x) {
+              u32 cell = y * size + x;
+              for (u32 j = cell_offsets[cell];
+                   j < cell_offsets[cell] + cell_counts[cell]; ++j) {
+                shadow += circleOverlap(position, radius,
+                                        glm::vec2(binned[j].x, binned[j].y),
+                                        binned[j].z) *
+                          SHADOW_OCCLUSION_SCALE * particles[i].opacity;
+              }
+            }
+          }
+
+          out_shadows[i] = 1.0f - shadow;
+        }
+      });
+}
+
+void shadowsDepthSorted(const Particle *particles, u32 count,
+                        const glm::mat4 &light_matrix, f32 min_transmittance,
+                        f32 *out_shadows) {
+  std::vector<u32> keys(count);
+  std::vector<u32> order(count);
+  std::vector<glm::vec4> light_data(count);
+  for (u32 i = 0; i < count; ++i) {
+    glm::vec2 position = lightProject(light_matrix, particles[i].pos);
+    keys[i] = lightDepthKey(lightDepth(light_matrix, particles[i].pos));
+    order[i] = i;
+    light_data[i] = glm::vec4(position.x, position.y, particles[i].radius,
+                              particles[i].opacity);
+  }
+
+  /* stable, like the GPU radix sort, so equal depths keep index order */
+  std::stable_sort(order.begin(), order.end(),
+                   [&](u32 a, u32 b) { return keys[a] < keys[b]; });
+
+  JobSystem::parallelFor(
+      count, SHADOW_JOB_CHUNK_SIZE, [&](u32 begin, u32 end) {
+        for (u32 rank = begin; rank < end; ++rank) {
+          glm::vec4 current = light_data[order[rank]];
+
+          f32 transmittance = 1.0f;
+          for (u32 i = 0; i < rank && transmittance > min_transmittance; ++i) {
+            glm::vec4 occluder = light_data[order[i]];
+            transmittance *=
+                1.0f - circleOverlap(glm::vec2(current.x, current.y),
+                                     current.z,
+                                     glm::vec2(occluder.x, occluder.y),
+                                     occluder.z) *
+                           SHADOW_OCCLUSION_SCALE * occluder.w;
+          }
+
+          out_shadows[order[rank]] = transmittance;
+        }
+      });
+}
\ No newline at end of file
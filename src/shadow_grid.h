@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core/platform.h"
+#include "particle_system.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#define SHADOW_GRID_SIZE 64
+/* the grid covers [-extent, extent]^2 in light space, particles outside are
+ * clamped into the border cells */
+#define SHADOW_GRID_EXTENT 4.0f
+#define SHADOW_OCCLUSION_SCALE 0.1f
+/* depth-sorted accumulation stops once this little light is left */
+#define SHADOW_MIN_TRANSMITTANCE 0.01f
+
+/* CPU reference of the light-space binning done by the particle_binning_*
+ * compute shaders: particles are counting-sorted into a 2D grid by their
+ * projected center and a receiver only visits the cells its disc, grown by
+ * the largest occluder radius, can overlap */
+struct ShadowGrid {
+  u32 size;
+  glm::vec4 bounds;
+  std::vector<u32> cell_counts;
+  std::vector<u32> cell_offsets;
+  /* light-space xy and radius, ordered by cell */
+  std::vector<glm::vec4> binned;
+
+  void create(u32 grid_size, glm::vec4 grid_bounds);
+
+  glm::ivec2 getCell(glm::vec2 position);
+
+  void build(const Particle *particles, u32 count,
+             const glm::mat4 &light_matrix);
+  void solve(const Particle *particles, u32 count,
+             const glm::mat4 &light_matrix, f32 max_radius, f32 *out_shadows);
+};
+
+/* depth-aware variant: only particles closer to the light occlude, each one
+ * attenuates the transmittance by its overlap weighted by its own opacity */
+void shadowsDepthSorted(const Particle *particles, u32 count,
+                        const glm::mat4 &light_matrix, f32 min_transmittance,
+                        f32 *out_shadows);
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "shadow_incremental.h"
+
+#include "core/logger.h"
+#include "particle_system.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "shadow_grid.h"
+
+#define INCREMENTAL_BINDING_COUNT 7
+
+b8 ShadowIncremental::create(VulkanDevice *device,
+                             VulkanMemoryAllocator *allocator,
+                             u32 frame_count) {
+  grid_size = SHADOW_GRID_SIZE;
+  grid_bounds = glm::vec4(-SHADOW_GRID_EXTENT, -SHADOW_GRID_EXTENT,
+                          SHADOW_GRID_EXTENT, SHADOW_GRID_EXTENT);
+
+  /* binding 0: particles, binding 1: shadows, binding 2: tracked particles,
+   * binding 3: cached shadows, binding 4: dirty cells, binding 5: dirty
+   * receivers, binding 6: indirect dispatch */
+  VkDescriptorSetLayoutBinding bindings[INCREMENTAL_BINDING_COUNT];
+  for (u32 i = 0; i < INCREMENTAL_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = INCREMENTAL_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsIncremental);
+
+  const char *shader_paths[3] = {
+      "assets/shaders/particle_incremental_motion.comp.spv",
+      "assets/shaders/particle_incremental_classify.comp.spv",
+      "assets/shaders/particle_shadowing_incremental.comp.spv"};
+  VulkanPipeline *pipelines[3] = {&motion_pipeline, &classify_pipeline,
+                                  &shadowing_pipeline};
+  for (u32 i = 0; i < 3; ++i) {
+    if (!pipelines[i]->createComputeFromFile(device, 1, &descriptor_set_layout,
+                                             1, &push_constant_range,
+                                             shader_paths[i])) {
+      ERROR("Failed to create an incremental shadowing pipeline!");
+      return false;
+    }
+  }
+
+  if (!dirty_cells_buffer.create(allocator,
+                                 sizeof(u32) * grid_size * grid_size,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a dirty cells buffer!");
+    return false;
+  }
+
+  if (!dispatch_buffer.create(allocator, sizeof(u32) * 4,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create an incremental dispatch buffer!");
+    return false;
+  }
+
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowIncremental::destroy(VulkanDevice *device,
+                                VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    destroyBuffers(allocator);
+  }
+
+  dispatch_buffer.destroy(allocator);
+  dirty_cells_buffer.destroy(allocator);
+
+  shadowing_pipeline.destroy(device);
+  classify_pipeline.destroy(device);
+  motion_pipeline.destroy(device);
+}
+
+b8 ShadowIncremental::createBuffers(VulkanMemoryAllocator *allocator,
+                                    u32 particle_capacity) {
+  capacity = particle_capacity;
+
+  if (!tracked_buffer.create(allocator, sizeof(glm::vec4) * capacity,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a tracked particles buffer!");
+    return false;
+  }
+  if (!cached_buffer.create(allocator, sizeof(f32) * capacity,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a cached shadows buffer!");
+    return false;
+  }
+  if (!dirty_receivers_buffer.create(allocator, sizeof(u32) * capacity,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a dirty receivers buffer!");
+    return false;
+  }
+
+  return true;
+}
+
+void ShadowIncremental::destroyBuffers(VulkanMemoryAllocator *allocator) {
+  dirty_receivers_buffer.destroy(allocator);
+  cached_buffer.destroy(allocator);
+  tracked_buffer.destroy(allocator);
+  capacity = 0;
+}
+
+b8 ShadowIncremental::prepare(VulkanDevice *device,
+                              VulkanMemoryAllocator *allocator,
+                              std::vector<FrameResources> &frames,
+                              u32 frame_index, u32 particle_count) {
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be reading the old buffers */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      destroyBuffers(allocator);
+    }
+    if (!createBuffers(allocator, new_capacity)) {
+      return false;
+    }
+
+    descriptor_set_generations.assign(frames.size(), 0);
+    invalidate();
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[INCREMENTAL_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer),
+      vulkanDescriptorBufferInfo(&tracked_buffer),
+      vulkanDescriptorBufferInfo(&cached_buffer),
+      vulkanDescriptorBufferInfo(&dirty_cells_buffer),
+      vulkanDescriptorBufferInfo(&dirty_receivers_buffer),
+      vulkanDescriptorBufferInfo(&dispatch_buffer),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < INCREMENTAL_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build an incremental shadowing descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+void ShadowIncremental::record(VulkanCommandBuffer *command_buffer,
+                               u32 frame_index, u32 particle_count,
+                               glm::vec4 sun_dir) {
+  /* particles appearing or disappearing have no tracked state to compare */
+  b8 full_refresh = !cache_valid || particle_count != cached_count ||
+                    sun_dir != cached_sun_dir;
+
+  PushConstantsIncremental push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.grid_bounds = grid_bounds;
+  push_constants.particle_count = particle_count;
+  push_constants.grid_size = grid_size;
+  push_constants.max_radius = PARTICLE_MAX_RADIUS;
+  push_constants.epsilon = SHADOW_INCREMENTAL_EPSILON;
+  push_constants.full_refresh = full_refresh;
+
+  u32 group_count =
+      (particle_count + INCREMENTAL_GROUP_SIZE - 1) / INCREMENTAL_GROUP_SIZE;
+
+  /* the previous frame may still be reading the shared tracking buffers and
+   * its dispatch arguments */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT);
+  command_buffer->bufferFill(&dirty_cells_buffer, 0);
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  /* motion, classify, then the shadowing pass over the dirty list, whose
+   * size only the classify pass knows */
+  VulkanPipeline *pipelines[3] = {&motion_pipeline, &classify_pipeline,
+                                  &shadowing_pipeline};
+  for (u32 i = 0; i < 3; ++i) {
+    if (i > 0) {
+      command_buffer->memoryBarrier(
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+          VK_ACCESS_SHADER_WRITE_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+              VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    }
+
+    command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+    command_buffer->descriptorSetBind(pipelines[i],
+                                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      descriptor_sets[frame_index], 0, 0, 0);
+    command_buffer->pushConstants(pipelines[i], VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                  sizeof(PushConstantsIncremental),
+                                  &push_constants);
+    if (i < 2) {
+      command_buffer->dispatch(group_count, 1);
+    } else {
+      command_buffer->dispatchIndirect(&dispatch_buffer, 0);
+    }
+  }
+
+  cache_valid = true;
+  cached_count = particle_count;
+  cached_sun_dir = sun_dir;
+}
+
+void ShadowIncremental::invalidate() { cache_valid = false; }
\ No newline at end of file
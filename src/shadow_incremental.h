@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+/* mirrored by INCREMENTAL_GROUP_SIZE in particle_incremental.glsl */
+#define INCREMENTAL_GROUP_SIZE 256
+/* light-space distance, radius or opacity change below which a particle
+ * counts as static */
+#define SHADOW_INCREMENTAL_EPSILON 1e-3f
+
+struct PushConstantsIncremental {
+  glm::vec4 sun_dir;
+  glm::vec4 grid_bounds;
+  u32 particle_count;
+  u32 grid_size;
+  f32 max_radius;
+  f32 epsilon;
+  u32 full_refresh;
+};
+
+/* brute force shadows recomputed only where something moved. A motion pass
+ * compares every particle against its state at the last solve and marks the
+ * light-space grid cells it could shade, before and after the move. A
+ * classify pass copies the cached result for the receivers outside marked
+ * cells and appends the others to a dirty list, counting the workgroups it
+ * needs. The shadowing pass is dispatched indirectly over that list, so the
+ * O(N) loop only runs for dirty receivers however they are spread over the
+ * particle indices. The tracking buffers persist across frames and are
+ * shared by the frames in flight */
+struct ShadowIncremental {
+  VulkanPipeline motion_pipeline;
+  VulkanPipeline classify_pipeline;
+  VulkanPipeline shadowing_pipeline;
+  VulkanBuffer dirty_cells_buffer;
+  /* VkDispatchIndirectCommand of the shadowing pass, then the list length */
+  VulkanBuffer dispatch_buffer;
+  VulkanBuffer dirty_receivers_buffer;
+  VulkanBuffer tracked_buffer;
+  VulkanBuffer cached_buffer;
+  u32 capacity = 0;
+  u32 grid_size;
+  glm::vec4 grid_bounds;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+  /* the cached shadows are only reusable for the same particles and light */
+  b8 cache_valid = false;
+  u32 cached_count = 0;
+  glm::vec4 cached_sun_dir;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the shared buffers waits for the device to go idle */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec4 sun_dir);
+
+  /* forces a full solve on the next record, e.g. after other shadow passes
+   * ran in between */
+  void invalidate();
+
+  b8 createBuffers(VulkanMemoryAllocator *allocator, u32 particle_capacity);
+  void destroyBuffers(VulkanMemoryAllocator *allocator);
+};
\ No newline at end of file
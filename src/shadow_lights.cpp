@@ -0,0 +1,178 @@
+#include "shadow_lights.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+
+#include <cstring>
+
+#define LIGHTS_BINDING_COUNT 4
+
+b8 ShadowLights::create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+                        u32 frame_count) {
+  /* binding 0: particles, binding 1: shadows, binding 2: lights,
+   * binding 3: per-light shadows */
+  VkDescriptorSetLayoutBinding bindings[LIGHTS_BINDING_COUNT];
+  for (u32 i = 0; i < LIGHTS_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = LIGHTS_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsLights);
+
+  /* a disc per occluder of the tile and light, plus the light transforms */
+  u32 shared_memory_size =
+      SHADOW_LIGHTS_GROUP_SIZE * SHADOW_MAX_LIGHTS * sizeof(glm::vec4) +
+      SHADOW_MAX_LIGHTS * sizeof(glm::mat4);
+  if (shared_memory_size >
+      device->properties.limits.maxComputeSharedMemorySize) {
+    ERROR("Multi-light shadowing needs %u bytes of shared memory, the device "
+          "has %u!",
+          shared_memory_size,
+          device->properties.limits.maxComputeSharedMemorySize);
+    return false;
+  }
+
+  if (!pipeline.createComputeFromFile(
+          device, 1, &descriptor_set_layout, 1, &push_constant_range,
+          "assets/shaders/particle_shadowing_lights.comp.spv")) {
+    ERROR("Failed to create a multi-light shadowing pipeline!");
+    return false;
+  }
+
+  lights_buffers.resize(frame_count);
+  for (u32 i = 0; i < frame_count; ++i) {
+    if (!lights_buffers[i].create(
+            allocator, sizeof(LightSource) * SHADOW_MAX_LIGHTS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+            VMA_ALLOCATION_CREATE_MAPPED_BIT)) {
+      ERROR("Failed to create a lights buffer!");
+      return false;
+    }
+  }
+
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowLights::destroy(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    light_shadows_buffer.destroy(allocator);
+  }
+
+  for (u32 i = 0; i < lights_buffers.size(); ++i) {
+    lights_buffers[i].destroy(allocator);
+  }
+
+  pipeline.destroy(device);
+}
+
+b8 ShadowLights::prepare(VulkanDevice *device,
+                         VulkanMemoryAllocator *allocator,
+                         std::vector<FrameResources> &frames, u32 frame_index,
+                         u32 particle_count, const LightSource *lights,
+                         u32 count) {
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be writing the old buffer */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      light_shadows_buffer.destroy(allocator);
+      capacity = 0;
+    }
+
+    if (!light_shadows_buffer.create(
+            allocator, sizeof(f32) * SHADOW_MAX_LIGHTS * new_capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VMA_MEMORY_USAGE_GPU_ONLY)) {
+      ERROR("Failed to create a per-light shadows buffer!");
+      return false;
+    }
+    capacity = new_capacity;
+
+    descriptor_set_generations.assign(frames.size(), 0);
+  }
+
+  light_count = count < SHADOW_MAX_LIGHTS ? count : SHADOW_MAX_LIGHTS;
+  VulkanBuffer &lights_buffer = lights_buffers[frame_index];
+  memcpy(lights_buffer.mapped, lights, sizeof(LightSource) * light_count);
+  lights_buffer.flush(allocator, 0, sizeof(LightSource) * light_count);
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[LIGHTS_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer),
+      vulkanDescriptorBufferInfo(&lights_buffer),
+      vulkanDescriptorBufferInfo(&light_shadows_buffer),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < LIGHTS_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build a multi-light shadowing descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+void ShadowLights::record(VulkanCommandBuffer *command_buffer,
+                          u32 frame_index, u32 particle_count) {
+  PushConstantsLights push_constants;
+  push_constants.particle_count = particle_count;
+  push_constants.light_count = light_count;
+
+  /* the previous frame may still be writing the shared per-light buffer */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT);
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, &pipeline);
+  command_buffer->descriptorSetBind(&pipeline, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_sets[frame_index], 0, 0, 0);
+  command_buffer->pushConstants(&pipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(PushConstantsLights), &push_constants);
+  command_buffer->dispatch(
+      (particle_count + SHADOW_LIGHTS_GROUP_SIZE - 1) /
+          SHADOW_LIGHTS_GROUP_SIZE,
+      1);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "light_space.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+/* mirrored by GROUP_SIZE and MAX_LIGHTS in particle_shadowing_lights.comp,
+ * together they bound the shared memory of a tile of discs per light */
+#define SHADOW_LIGHTS_GROUP_SIZE 64
+#define SHADOW_MAX_LIGHTS 8
+
+struct PushConstantsLights {
+  u32 particle_count;
+  u32 light_count;
+};
+
+/* the brute force shadow pass against several directional and point lights
+ * in one dispatch. Every occluder tile is loaded and projected once per
+ * workgroup for all of the lights, instead of once per light per dispatch.
+ *
+ * Per-light results go to light_shadows_buffer as
+ * shadows[particle * light_count + light], the frame's shadows buffer gets
+ * their intensity weighted mean. The lights are uploaded per frame, the
+ * per-light buffer is shared by the frames in flight */
+struct ShadowLights {
+  VulkanPipeline pipeline;
+  std::vector<VulkanBuffer> lights_buffers;
+  VulkanBuffer light_shadows_buffer;
+  /* in particles, every one has room for SHADOW_MAX_LIGHTS results */
+  u32 capacity = 0;
+  u32 light_count = 0;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the per-light buffer waits for the device to go idle. Lights past
+   * SHADOW_MAX_LIGHTS are dropped */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count, const LightSource *lights, u32 count);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count);
+};
\ No newline at end of file
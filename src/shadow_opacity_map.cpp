@@ -0,0 +1,386 @@
+#include "shadow_opacity_map.h"
+
+#include "core/file_system.h"
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+#include "renderer/vulkan/vulkan_shader_module.h"
+#include "shadow_grid.h"
+
+#define OPACITY_MAP_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+/* the coefficients of far apart particles cancel out, half precision would
+ * leave noise behind. Blending into it is optional, see fourierFormatPick */
+#define OPACITY_MAP_FOURIER_FORMAT VK_FORMAT_R32G32B32A32_SFLOAT
+/* must support blending on every device */
+#define OPACITY_MAP_FOURIER_FALLBACK_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define OPACITY_MAP_BINDING_COUNT 6
+#define OPACITY_MAP_BUFFER_BINDING_COUNT 3
+
+static b8 targetCreate(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+                       VkFormat format, u32 texture_count,
+                       VulkanTexture *textures, VulkanRenderPass *render_pass,
+                       VulkanFramebuffer *framebuffer) {
+  std::vector<VkImageView> attachments;
+  for (u32 i = 0; i < texture_count; ++i) {
+    /* edges are empty unless particles leave the map, clamping keeps them
+     * from wrapping around */
+    if (!textures[i].create(device, allocator, format, OPACITY_MAP_SIZE,
+                            OPACITY_MAP_SIZE,
+                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                VK_IMAGE_USAGE_SAMPLED_BIT,
+                            VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)) {
+      ERROR("Failed to create an opacity map!");
+      return false;
+    }
+    attachments.push_back(textures[i].view);
+  }
+
+  if (!render_pass->createOffscreen(device, format, texture_count)) {
+    ERROR("Failed to create an opacity map render pass!");
+    return false;
+  }
+
+  if (!framebuffer->create(device, render_pass, attachments, OPACITY_MAP_SIZE,
+                           OPACITY_MAP_SIZE)) {
+    ERROR("Failed to create an opacity map framebuffer!");
+    return false;
+  }
+
+  return true;
+}
+
+/* the splat adds the coefficients with blending, which RGBA32F attachments
+ * are not required to support */
+static VkFormat fourierFormatPick(VulkanDevice *device) {
+  VkFormatProperties format_properties;
+  vkGetPhysicalDeviceFormatProperties(device->physical_device,
+                                      OPACITY_MAP_FOURIER_FORMAT,
+                                      &format_properties);
+  if (format_properties.optimalTilingFeatures &
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT) {
+    return OPACITY_MAP_FOURIER_FORMAT;
+  }
+
+  WARN("No blending into RGBA32F, the Fourier opacity map falls back to "
+       "RGBA16F and is noisier");
+  return OPACITY_MAP_FOURIER_FALLBACK_FORMAT;
+}
+
+static b8 splatPipelineCreate(VulkanDevice *device,
+                              VulkanRenderPass *render_pass,
+                              VkDescriptorSetLayout *descriptor_set_layout,
+                              VkPushConstantRange *push_constant_range,
+                              const char *fragment_shader_path,
+                              u32 attachment_count, VulkanPipeline *pipeline) {
+  VulkanShaderModule vertex_shader_module;
+  VulkanShaderModule fragment_shader_module;
+  if (!vertex_shader_module.create(
+          device,
+          FileSystem::joinPath("assets/shaders/opacity_map_splat.vert.spv")
+              .c_str())) {
+    ERROR("Failed to load the opacity map splat vertex shader!");
+    return false;
+  }
+  if (!fragment_shader_module.create(
+          device, FileSystem::joinPath(fragment_shader_path).c_str())) {
+    ERROR("Failed to load an opacity map splat fragment shader!");
+    vertex_shader_module.destroy(device);
+    return false;
+  }
+
+  VkPipelineShaderStageCreateInfo stage_infos[2] = {
+      vulkanPipelineShaderStageCreateInfo(&vertex_shader_module,
+                                          VK_SHADER_STAGE_VERTEX_BIT),
+      vulkanPipelineShaderStageCreateInfo(&fragment_shader_module,
+                                          VK_SHADER_STAGE_FRAGMENT_BIT)};
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = OPACITY_MAP_SIZE;
+  viewport.height = OPACITY_MAP_SIZE;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor = {};
+  scissor.offset.x = 0;
+  scissor.offset.y = 0;
+  scissor.extent.width = OPACITY_MAP_SIZE;
+  scissor.extent.height = OPACITY_MAP_SIZE;
+
+  /* optical depths and coefficients add up, the fragment shaders weight them
+   * by overlap */
+  std::vector<VkPipelineColorBlendAttachmentState> blend_attachment_states(
+      attachment_count);
+  for (u32 i = 0; i < attachment_count; ++i) {
+    VkPipelineColorBlendAttachmentState &state = blend_attachment_states[i];
+    state.blendEnable = VK_TRUE;
+    state.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.colorBlendOp = VK_BLEND_OP_ADD;
+    state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    state.alphaBlendOp = VK_BLEND_OP_ADD;
+    state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                           VK_COLOR_COMPONENT_G_BIT |
+                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  }
+
+  b8 created = pipeline->createGraphics(
+      device, render_pass, 1, descriptor_set_layout, 2, stage_infos, 1,
+      push_constant_range, 0, 0, viewport, scissor, 0,
+      blend_attachment_states.data(), attachment_count, true);
+
+  fragment_shader_module.destroy(device);
+  vertex_shader_module.destroy(device);
+
+  if (!created) {
+    ERROR("Failed to create an opacity map splat pipeline!");
+    return false;
+  }
+
+  return true;
+}
+
+b8 ShadowOpacityMap::create(VulkanDevice *device,
+                            VulkanMemoryAllocator *allocator,
+                            u32 frame_count) {
+  if (!targetCreate(device, allocator, OPACITY_MAP_FORMAT, 1, &map,
+                    &render_pass, &framebuffer) ||
+      !targetCreate(device, allocator, fourierFormatPick(device),
+                    OPACITY_MAP_FOURIER_TEXTURES, fourier_maps,
+                    &fourier_render_pass, &fourier_framebuffer)) {
+    return false;
+  }
+
+  if (!depth_range_buffer.create(allocator, sizeof(u32) * 2,
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY)) {
+    ERROR("Failed to create a depth range buffer!");
+    return false;
+  }
+
+  /* binding 0: particles, binding 1: shadows, binding 2: depth range,
+   * binding 3: slice map, binding 4-5: Fourier maps */
+  VkDescriptorSetLayoutBinding bindings[OPACITY_MAP_BINDING_COUNT];
+  for (u32 i = 0; i < OPACITY_MAP_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i,
+        i < OPACITY_MAP_BUFFER_BINDING_COUNT
+            ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+            : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = OPACITY_MAP_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsOpacityMap);
+
+  VulkanPipeline *compute_pipelines[3] = {&range_pipeline, &shadowing_pipeline,
+                                          &fourier_shadowing_pipeline};
+  const char *compute_shader_paths[3] = {
+      "assets/shaders/opacity_map_range.comp.spv",
+      "assets/shaders/particle_shadowing_opacity_map.comp.spv",
+      "assets/shaders/particle_shadowing_fourier.comp.spv"};
+  for (u32 i = 0; i < 3; ++i) {
+    if (!compute_pipelines[i]->createComputeFromFile(
+            device, 1, &descriptor_set_layout, 1, &push_constant_range,
+            compute_shader_paths[i])) {
+      ERROR("Failed to create an opacity map compute pipeline!");
+      return false;
+    }
+  }
+
+  if (!splatPipelineCreate(device, &render_pass, &descriptor_set_layout,
+                           &push_constant_range,
+                           "assets/shaders/opacity_map_splat.frag.spv", 1,
+                           &splat_pipeline) ||
+      !splatPipelineCreate(
+          device, &fourier_render_pass, &descriptor_set_layout,
+          &push_constant_range,
+          "assets/shaders/opacity_map_fourier_splat.frag.spv",
+          OPACITY_MAP_FOURIER_TEXTURES, &fourier_splat_pipeline)) {
+    return false;
+  }
+
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowOpacityMap::destroy(VulkanDevice *device,
+                               VulkanMemoryAllocator *allocator) {
+  fourier_splat_pipeline.destroy(device);
+  fourier_shadowing_pipeline.destroy(device);
+  splat_pipeline.destroy(device);
+  shadowing_pipeline.destroy(device);
+  range_pipeline.destroy(device);
+  depth_range_buffer.destroy(allocator);
+  fourier_framebuffer.destroy(device);
+  fourier_render_pass.destroy(device);
+  for (u32 i = 0; i < OPACITY_MAP_FOURIER_TEXTURES; ++i) {
+    fourier_maps[i].destroy(device, allocator);
+  }
+  framebuffer.destroy(device);
+  render_pass.destroy(device);
+  map.destroy(device, allocator);
+}
+
+b8 ShadowOpacityMap::prepare(VulkanDevice *device,
+                             std::vector<FrameResources> &frames,
+                             u32 frame_index) {
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[OPACITY_MAP_BUFFER_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer),
+      vulkanDescriptorBufferInfo(&depth_range_buffer),
+  };
+  VkDescriptorImageInfo image_infos[1 + OPACITY_MAP_FOURIER_TEXTURES] = {
+      vulkanDescriptorImageInfo(&map,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+      vulkanDescriptorImageInfo(&fourier_maps[0],
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+      vulkanDescriptorImageInfo(&fourier_maps[1],
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < OPACITY_MAP_BINDING_COUNT; ++i) {
+    if (i < OPACITY_MAP_BUFFER_BINDING_COUNT) {
+      builder.bufferBind(i, &buffer_infos[i],
+                         VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                         VK_SHADER_STAGE_VERTEX_BIT |
+                             VK_SHADER_STAGE_COMPUTE_BIT);
+    } else {
+      builder.imageBind(i, &image_infos[i - OPACITY_MAP_BUFFER_BINDING_COUNT],
+                        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        VK_SHADER_STAGE_VERTEX_BIT |
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build an opacity map descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+void ShadowOpacityMap::record(VulkanCommandBuffer *command_buffer,
+                              u32 frame_index, u32 particle_count,
+                              glm::vec4 sun_dir,
+                              OpacityMapEncoding encoding) {
+  PushConstantsOpacityMap push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.extent = SHADOW_GRID_EXTENT;
+  push_constants.particle_count = particle_count;
+  push_constants.occlusion_scale = SHADOW_OCCLUSION_SCALE;
+  push_constants.min_transmittance = SHADOW_MIN_TRANSMITTANCE;
+
+  u32 group_count =
+      (particle_count + OPACITY_MAP_GROUP_SIZE - 1) / OPACITY_MAP_GROUP_SIZE;
+  VkShaderStageFlags push_constant_stages =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+  b8 fourier = encoding == OPACITY_MAP_ENCODING_FOURIER;
+  VulkanRenderPass *target_render_pass =
+      fourier ? &fourier_render_pass : &render_pass;
+  VulkanFramebuffer *target_framebuffer =
+      fourier ? &fourier_framebuffer : &framebuffer;
+  VulkanPipeline *target_splat_pipeline =
+      fourier ? &fourier_splat_pipeline : &splat_pipeline;
+  VulkanPipeline *target_shadowing_pipeline =
+      fourier ? &fourier_shadowing_pipeline : &shadowing_pipeline;
+
+  /* the previous frame may still be reading the depth range */
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT);
+  command_buffer->bufferFill(&depth_range_buffer, 0xffffffff);
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE,
+                               &range_pipeline);
+  command_buffer->descriptorSetBind(&range_pipeline,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_sets[frame_index], 0, 0, 0);
+  command_buffer->pushConstants(&range_pipeline, push_constant_stages, 0,
+                                sizeof(PushConstantsOpacityMap),
+                                &push_constants);
+  command_buffer->dispatch(group_count, 1);
+
+  command_buffer->memoryBarrier(
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+  /* every target starts from zero, the single color clear would leave the
+   * second Fourier map with a depth clear value */
+  VkClearValue clear_values[OPACITY_MAP_FOURIER_TEXTURES] = {};
+  glm::vec4 render_area = {0, 0, OPACITY_MAP_SIZE, OPACITY_MAP_SIZE};
+  command_buffer->renderPassBegin(
+      target_render_pass, target_framebuffer,
+      fourier ? OPACITY_MAP_FOURIER_TEXTURES : 1, clear_values, render_area);
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_GRAPHICS,
+                               target_splat_pipeline);
+  command_buffer->descriptorSetBind(target_splat_pipeline,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    descriptor_sets[frame_index], 0, 0, 0);
+  command_buffer->pushConstants(target_splat_pipeline, push_constant_stages,
+                                0, sizeof(PushConstantsOpacityMap),
+                                &push_constants);
+  /* a quad per particle, the corners come from gl_VertexIndex */
+  command_buffer->draw(6, particle_count);
+  command_buffer->renderPassEnd();
+
+  command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE,
+                               target_shadowing_pipeline);
+  command_buffer->descriptorSetBind(target_shadowing_pipeline,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    descriptor_sets[frame_index], 0, 0, 0);
+  command_buffer->pushConstants(target_shadowing_pipeline,
+                                push_constant_stages, 0,
+                                sizeof(PushConstantsOpacityMap),
+                                &push_constants);
+  command_buffer->dispatch(group_count, 1);
+
+  /* read by the particle shaders of the main render pass */
+  command_buffer->memoryBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_ACCESS_SHADER_READ_BIT);
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_framebuffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+#include "renderer/vulkan/vulkan_render_pass.h"
+#include "renderer/vulkan/vulkan_texture.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define OPACITY_MAP_SIZE 512
+/* one per channel of the map, mirrored in opacity_map.glsl */
+#define OPACITY_MAP_SLICES 4
+#define OPACITY_MAP_GROUP_SIZE 256
+/* a0 .. b3, seven coefficients over two RGBA maps */
+#define OPACITY_MAP_FOURIER_TEXTURES 2
+
+enum OpacityMapEncoding {
+  /* optical depth at the far end of OPACITY_MAP_SLICES depth slices */
+  OPACITY_MAP_ENCODING_SLICES,
+  /* Fourier series of the absorption over depth up to the third frequency */
+  OPACITY_MAP_ENCODING_FOURIER,
+};
+
+struct PushConstantsOpacityMap {
+  glm::vec4 sun_dir;
+  f32 extent;
+  u32 particle_count;
+  f32 occlusion_scale;
+  f32 min_transmittance;
+};
+
+/* deep opacity map: every particle's disc is splatted with additive blending
+ * into a light-space render target, with the particles' depth range split
+ * into OPACITY_MAP_SLICES slices, one per channel. Each particle then reads
+ * the optical depth in front of it at its own position, which is O(N +
+ * pixels) instead of O(N^2). Approximates the depth-sorted solve, occluders
+ * count as if the receiver had their radius.
+ *
+ * The Fourier encoding instead adds every particle's coefficients, so the
+ * optical depth up to any depth is reconstructed from a fixed seven values
+ * per texel, without slice boundaries. The truncated series smooths and
+ * rings around dense clusters.
+ *
+ * The splat is a graphics pass, so record goes into a graphics command
+ * buffer. The maps and depth range are shared by the frames in flight */
+struct ShadowOpacityMap {
+  VulkanTexture map;
+  VulkanRenderPass render_pass;
+  VulkanFramebuffer framebuffer;
+  VulkanPipeline splat_pipeline;
+  VulkanPipeline shadowing_pipeline;
+  VulkanTexture fourier_maps[OPACITY_MAP_FOURIER_TEXTURES];
+  VulkanRenderPass fourier_render_pass;
+  VulkanFramebuffer fourier_framebuffer;
+  VulkanPipeline fourier_splat_pipeline;
+  VulkanPipeline fourier_shadowing_pipeline;
+  VulkanPipeline range_pipeline;
+  VulkanBuffer depth_range_buffer;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+            u32 frame_count);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on */
+  b8 prepare(VulkanDevice *device, std::vector<FrameResources> &frames,
+             u32 frame_index);
+
+  /* outside of any render pass */
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec4 sun_dir,
+              OpacityMapEncoding encoding);
+};
\ No newline at end of file
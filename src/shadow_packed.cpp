@@ -0,0 +1,167 @@
+#include "shadow_packed.h"
+
+#include "core/logger.h"
+#include "renderer/vulkan/vulkan_command_buffer.h"
+#include "renderer/vulkan/vulkan_descriptor_set_builder.h"
+#include "renderer/vulkan/vulkan_descriptor_set_layout_cache.h"
+
+#define PACKED_BINDING_COUNT 3
+
+b8 ShadowPacked::create(VulkanDevice *device, u32 frame_count,
+                        ShadowTuning tuning) {
+  half_precision = device->storage_buffer_16bit;
+
+  /* binding 0: particles, binding 1: shadows, binding 2: packed particles */
+  VkDescriptorSetLayoutBinding bindings[PACKED_BINDING_COUNT];
+  for (u32 i = 0; i < PACKED_BINDING_COUNT; ++i) {
+    bindings[i] = vulkanDescriptorSetLayoutBinding(
+        i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+
+  VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
+  descriptor_set_layout_create_info.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_set_layout_create_info.pNext = 0;
+  descriptor_set_layout_create_info.flags = 0;
+  descriptor_set_layout_create_info.bindingCount = PACKED_BINDING_COUNT;
+  descriptor_set_layout_create_info.pBindings = bindings;
+
+  VkDescriptorSetLayout descriptor_set_layout =
+      VulkanDescriptorSetLayoutCache::layoutCreate(
+          device, &descriptor_set_layout_create_info);
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(PushConstantsCompute);
+
+  const char *shader_paths[2] = {
+      half_precision ? "assets/shaders/particle_light_pack_f16.comp.spv"
+                     : "assets/shaders/particle_light_pack.comp.spv",
+      half_precision ? "assets/shaders/particle_shadowing_packed_f16.comp.spv"
+                     : "assets/shaders/particle_shadowing_packed.comp.spv"};
+  VulkanSpecialization specialization = shadowTuningSpecialization(tuning);
+  VkSpecializationInfo specialization_info = specialization.getInfo();
+  const VkSpecializationInfo *specialization_infos[2] = {0,
+                                                         &specialization_info};
+  VulkanPipeline *pipelines[2] = {&pack_pipeline, &shadowing_pipeline};
+  for (u32 i = 0; i < 2; ++i) {
+    if (!pipelines[i]->createComputeFromFile(
+            device, 1, &descriptor_set_layout, 1, &push_constant_range,
+            shader_paths[i], specialization_infos[i])) {
+      ERROR("Failed to create a packed shadowing pipeline!");
+      return false;
+    }
+  }
+
+  shadowing_group_size = tuning.group_size;
+
+  INFO("Packed shadowing: %s particles", half_precision ? "f16x4" : "fp32x4");
+
+  descriptor_sets.resize(frame_count);
+  /* generation 0 is never handed out by FrameResources, so every set is
+   * built on first use */
+  descriptor_set_generations.assign(frame_count, 0);
+
+  return true;
+}
+
+void ShadowPacked::destroy(VulkanDevice *device,
+                           VulkanMemoryAllocator *allocator) {
+  if (capacity > 0) {
+    packed_buffer.destroy(allocator);
+  }
+
+  shadowing_pipeline.destroy(device);
+  pack_pipeline.destroy(device);
+}
+
+b8 ShadowPacked::prepare(VulkanDevice *device,
+                         VulkanMemoryAllocator *allocator,
+                         std::vector<FrameResources> &frames, u32 frame_index,
+                         u32 particle_count) {
+  if (particle_count > capacity) {
+    /* the other frames in flight may still be reading the old buffer */
+    device->waitIdle();
+
+    u32 new_capacity = capacity * 2;
+    if (new_capacity < particle_count) {
+      new_capacity = particle_count;
+    }
+
+    if (capacity > 0) {
+      packed_buffer.destroy(allocator);
+      capacity = 0;
+    }
+
+    u32 stride = half_precision ? sizeof(u16) * 4 : sizeof(glm::vec4);
+    if (!packed_buffer.create(allocator, stride * new_capacity,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY)) {
+      ERROR("Failed to create a packed particles buffer!");
+      return false;
+    }
+    capacity = new_capacity;
+
+    descriptor_set_generations.assign(frames.size(), 0);
+  }
+
+  FrameResources &frame = frames[frame_index];
+  if (descriptor_set_generations[frame_index] == frame.generation) {
+    return true;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[PACKED_BINDING_COUNT] = {
+      vulkanDescriptorBufferInfo(&frame.particles_buffer),
+      vulkanDescriptorBufferInfo(&frame.shadows_buffer),
+      vulkanDescriptorBufferInfo(&packed_buffer),
+  };
+
+  VulkanDescriptorSetBuilder builder;
+  builder.begin();
+  for (u32 i = 0; i < PACKED_BINDING_COUNT; ++i) {
+    builder.bufferBind(i, &buffer_infos[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT);
+  }
+  if (!builder.end(device, &descriptor_sets[frame_index])) {
+    ERROR("Failed to build a packed shadowing descriptor set!");
+    return false;
+  }
+
+  descriptor_set_generations[frame_index] = frame.generation;
+
+  return true;
+}
+
+void ShadowPacked::record(VulkanCommandBuffer *command_buffer,
+                          u32 frame_index, u32 particle_count,
+                          glm::vec4 sun_dir) {
+  PushConstantsCompute push_constants;
+  push_constants.sun_dir = sun_dir;
+  push_constants.particle_count = particle_count;
+
+  u32 group_counts[2] = {
+      (particle_count + PACKED_GROUP_SIZE - 1) / PACKED_GROUP_SIZE,
+      (particle_count + shadowing_group_size - 1) / shadowing_group_size};
+
+  VulkanPipeline *pipelines[2] = {&pack_pipeline, &shadowing_pipeline};
+  for (u32 i = 0; i < 2; ++i) {
+    /* before the pack pass: the previous frame may still be reading the
+     * shared packed buffer */
+    command_buffer->memoryBarrier(
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    command_buffer->pipelineBind(VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+    command_buffer->descriptorSetBind(pipelines[i],
+                                      VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      descriptor_sets[frame_index], 0, 0, 0);
+    command_buffer->pushConstants(pipelines[i], VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                  sizeof(PushConstantsCompute),
+                                  &push_constants);
+    command_buffer->dispatch(group_counts[i], 1);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "core/platform.h"
+#include "frame_resources.h"
+#include "renderer/vulkan/vulkan_buffer.h"
+#include "renderer/vulkan/vulkan_pipeline.h"
+#include "shadow_brute_force.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct VulkanCommandBuffer;
+
+#define PACKED_GROUP_SIZE 256
+
+/* the brute force shadow pass over a compact copy of the particles: a first
+ * pass projects them into light space and stores xy, radius and opacity as
+ * f16x4 (8 bytes) with 16-bit storage buffer access, or as fp32 (16 bytes)
+ * without it, instead of the 32-byte Particle. The packed buffer is shared by
+ * the frames in flight, record orders consecutive frames with barriers.
+ * The shadowing kernel runs with ShadowBruteForce's tuned workgroup and tile
+ * sizes */
+struct ShadowPacked {
+  VulkanPipeline pack_pipeline;
+  VulkanPipeline shadowing_pipeline;
+  VulkanBuffer packed_buffer;
+  u32 capacity = 0;
+  b8 half_precision;
+  u32 shadowing_group_size;
+  std::vector<VkDescriptorSet> descriptor_sets;
+  /* FrameResources::generation each descriptor set was built against */
+  std::vector<u32> descriptor_set_generations;
+
+  b8 create(VulkanDevice *device, u32 frame_count, ShadowTuning tuning);
+  void destroy(VulkanDevice *device, VulkanMemoryAllocator *allocator);
+
+  /* must only be called once the frame's fences have been waited on, growing
+   * the packed buffer waits for the device to go idle */
+  b8 prepare(VulkanDevice *device, VulkanMemoryAllocator *allocator,
+             std::vector<FrameResources> &frames, u32 frame_index,
+             u32 particle_count);
+
+  void record(VulkanCommandBuffer *command_buffer, u32 frame_index,
+              u32 particle_count, glm::vec4 sun_dir);
+};
\ No newline at end of file
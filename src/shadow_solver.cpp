@@ -0,0 +1,287 @@
+#include "shadow_solver.h"
+
+#include "core/cpu.h"
+#include "core/job_system.h"
+#include "light_space.h"
+#include "shadow_grid.h"
+
+#include <cmath>
+#include <vector>
+
+#ifdef ARCH_X64
+#include <immintrin.h>
+#endif
+
+static void solveRangeScalar(const ShadowSolver *solver, u32 begin, u32 end,
+                             f32 *out_shadows);
+#ifdef ARCH_X64
+TARGET_AVX2 static void solveRangeAVX2(const ShadowSolver *solver, u32 begin,
+                                       u32 end, f32 *out_shadows);
+#endif
+
+void ShadowSolver::create(b8 allow_simd) {
+  solve_range = solveRangeScalar;
+#ifdef ARCH_X64
+  if (allow_simd && Cpu::hasAVX2()) {
+    solve_range = solveRangeAVX2;
+  }
+#endif
+}
+
+void ShadowSolver::project(const Particle *particles, u32 particle_count,
+                           const glm::mat4 &light_matrix) {
+  count = particle_count;
+  x.resize(count);
+  y.resize(count);
+  radius.resize(count);
+  opacity.resize(count);
+
+  for (u32 i = 0; i < count; ++i) {
+    glm::vec2 position = lightProject(light_matrix, particles[i].pos);
+    x[i] = position.x;
+    y[i] = position.y;
+    radius[i] = particles[i].radius;
+    opacity[i] = particles[i].opacity;
+  }
+}
+
+void ShadowSolver::project(const ParticleSystem *particle_system,
+                           const glm::mat4 &light_matrix) {
+  count = particle_system->count;
+  x.resize(count);
+  y.resize(count);
+  radius.resize(count);
+  opacity.resize(count);
+
+  JobSystem::parallelFor(
+      count, SHADOW_SOLVER_JOB_SIZE, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; ++i) {
+          glm::vec2 position = lightProject(
+              light_matrix,
+              glm::vec3(particle_system->x[i], particle_system->y[i],
+                        particle_system->z[i]));
+          x[i] = position.x;
+          y[i] = position.y;
+          radius[i] = particle_system->radius[i];
+          opacity[i] = particle_system->opacity[i];
+        }
+      });
+}
+
+void ShadowSolver::project(const Particle *particles, u32 particle_count,
+                           const LightSource &light) {
+  count = particle_count;
+  x.resize(count);
+  y.resize(count);
+  radius.resize(count);
+  opacity.resize(count);
+
+  glm::mat4 transform = lightTransform(light);
+  for (u32 i = 0; i < count; ++i) {
+    glm::vec3 disc = lightProjectDisc(light, transform, particles[i].pos,
+                                      particles[i].radius);
+    x[i] = disc.x;
+    y[i] = disc.y;
+    radius[i] = disc.z;
+    opacity[i] = particles[i].opacity;
+  }
+}
+
+void ShadowSolver::solve(f32 *out_shadows) {
+  JobSystem::parallelFor(count, SHADOW_SOLVER_JOB_SIZE,
+                         [&](u32 begin, u32 end) {
+                           solve_range(this, begin, end, out_shadows);
+                         });
+}
+
+static void solveRangeScalar(const ShadowSolver *solver, u32 begin, u32 end,
+                             f32 *out_shadows) {
+  for (u32 i = begin; i < end; ++i) {
+    glm::vec2 position = glm::vec2(solver->x[i], solver->y[i]);
+
+    f32 shadow = 0.0f;
+    for (u32 j = 0; j < solver->count; ++j) {
+      shadow += circleOverlap(position, solver->radius[i],
+                              glm::vec2(solver->x[j], solver->y[j]),
+                              solver->radius[j]) *
+                SHADOW_OCCLUSION_SCALE * solver->opacity[i];
+    }
+
+    out_shadows[i] = 1.0f - shadow;
+  }
+}
+
+#ifdef ARCH_X64
+/* Abramowitz & Stegun 4.4.46, |error| <= 2e-8 on [0, 1], mirrored for
+ * negative arguments. x must already be clamped to [-1, 1] */
+TARGET_AVX2 static __m256 acosAVX2(__m256 x) {
+  __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  __m256 negative = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+  __m256 a = _mm256_andnot_ps(sign_mask, x);
+
+  __m256 p = _mm256_set1_ps(-0.0012624911f);
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(0.0066700901f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(-0.0170881256f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(0.0308918810f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(-0.0501743046f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(0.0889789874f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(-0.2145988016f));
+  p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(1.5707963050f));
+
+  __m256 result =
+      _mm256_mul_ps(p, _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a)));
+
+  return _mm256_blendv_ps(
+      result, _mm256_sub_ps(_mm256_set1_ps(3.14159265359f), result), negative);
+}
+
+/* area of the circular segment of a disc of radius r cut at distance d from
+ * its center, the first term of circleOverlap's area1/area2 */
+TARGET_AVX2 static __m256 segmentAreaAVX2(__m256 d, __m256 r, __m256 r2) {
+  __m256 one = _mm256_set1_ps(1.0f);
+  __m256 cosine = _mm256_div_ps(d, r);
+  cosine = _mm256_max_ps(_mm256_min_ps(cosine, one), _mm256_set1_ps(-1.0f));
+
+  __m256 chord = _mm256_sqrt_ps(_mm256_max_ps(
+      _mm256_sub_ps(r2, _mm256_mul_ps(d, d)), _mm256_setzero_ps()));
+
+  return _mm256_sub_ps(_mm256_mul_ps(acosAVX2(cosine), r2),
+                       _mm256_mul_ps(d, chord));
+}
+
+/* 8 receivers per batch against one broadcast occluder at a time, occluders
+ * are walked in tiles so that every batch of the job reuses the tile while it
+ * is in cache. Lanes that do not overlap skip the expensive part as long as
+ * the whole batch misses */
+TARGET_AVX2 static void solveRangeAVX2(const ShadowSolver *solver, u32 begin,
+                                       u32 end, f32 *out_shadows) {
+  u32 batch_end = begin + ((end - begin) & ~7u);
+
+  __m256 zero = _mm256_setzero_ps();
+  __m256 one = _mm256_set1_ps(1.0f);
+  __m256 two = _mm256_set1_ps(2.0f);
+  __m256 inverse_pi = _mm256_set1_ps(1.0f / 3.14159265359f);
+  __m256 min_distance = _mm256_set1_ps(1e-30f);
+  __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+  for (u32 i = begin; i < batch_end; i += 8) {
+    _mm256_storeu_ps(out_shadows + i, zero);
+  }
+
+  for (u32 tile = 0; tile < solver->count; tile += SHADOW_SOLVER_TILE_SIZE) {
+    u32 tile_end = tile + SHADOW_SOLVER_TILE_SIZE;
+    if (tile_end > solver->count) {
+      tile_end = solver->count;
+    }
+
+    for (u32 i = begin; i < batch_end; i += 8) {
+      __m256 x1 = _mm256_load_ps(solver->x.data() + i);
+      __m256 y1 = _mm256_load_ps(solver->y.data() + i);
+      __m256 r1 = _mm256_load_ps(solver->radius.data() + i);
+      __m256 r1_squared = _mm256_mul_ps(r1, r1);
+
+      __m256 overlap_sum = _mm256_loadu_ps(out_shadows + i);
+
+      for (u32 j = tile; j < tile_end; ++j) {
+        __m256 r2 = _mm256_set1_ps(solver->radius[j]);
+        __m256 dx = _mm256_sub_ps(x1, _mm256_set1_ps(solver->x[j]));
+        __m256 dy = _mm256_sub_ps(y1, _mm256_set1_ps(solver->y[j]));
+        __m256 distance_squared =
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+        __m256 reach = _mm256_add_ps(r1, r2);
+        __m256 overlapping = _mm256_cmp_ps(
+            distance_squared, _mm256_mul_ps(reach, reach), _CMP_LT_OQ);
+        if (_mm256_movemask_ps(overlapping) == 0) {
+          continue;
+        }
+
+        __m256 r2_squared = _mm256_mul_ps(r2, r2);
+        __m256 distance = _mm256_sqrt_ps(distance_squared);
+        __m256 contained = _mm256_cmp_ps(
+            distance, _mm256_andnot_ps(sign_mask, _mm256_sub_ps(r1, r2)),
+            _CMP_LE_OQ);
+
+        /* contained lanes, including coincident centers, are blended away,
+         * the clamp only keeps the division finite */
+        __m256 safe_distance = _mm256_max_ps(distance, min_distance);
+        __m256 d = _mm256_div_ps(
+            _mm256_add_ps(_mm256_sub_ps(r1_squared, r2_squared),
+                          distance_squared),
+            _mm256_mul_ps(two, safe_distance));
+
+        __m256 area = _mm256_add_ps(
+            segmentAreaAVX2(d, r1, r1_squared),
+            segmentAreaAVX2(_mm256_sub_ps(distance, d), r2, r2_squared));
+        __m256 overlap = _mm256_div_ps(
+            _mm256_mul_ps(area, inverse_pi),
+            _mm256_add_ps(r1_squared, r2_squared));
+
+        overlap = _mm256_blendv_ps(overlap, one, contained);
+        overlap = _mm256_and_ps(overlap, overlapping);
+
+        overlap_sum = _mm256_add_ps(overlap_sum, overlap);
+      }
+
+      _mm256_storeu_ps(out_shadows + i, overlap_sum);
+    }
+  }
+
+  __m256 scale = _mm256_set1_ps(SHADOW_OCCLUSION_SCALE);
+  for (u32 i = begin; i < batch_end; i += 8) {
+    __m256 opacity = _mm256_load_ps(solver->opacity.data() + i);
+    __m256 shadow = _mm256_mul_ps(_mm256_loadu_ps(out_shadows + i),
+                                  _mm256_mul_ps(scale, opacity));
+    _mm256_storeu_ps(out_shadows + i, _mm256_sub_ps(one, shadow));
+  }
+
+  solveRangeScalar(solver, batch_end, end, out_shadows);
+}
+#endif
+
+void shadowsBruteForce(const Particle *particles, u32 count,
+                       const glm::mat4 &light_matrix, f32 *out_shadows) {
+  ShadowSolver solver;
+  solver.create(false);
+  solver.project(particles, count, light_matrix);
+  solver.solve(out_shadows);
+}
+
+void shadowsBruteForceLights(const Particle *particles, u32 count,
+                             const LightSource *lights, u32 light_count,
+                             f32 *out_light_shadows, f32 *out_shadows) {
+  ShadowSolver solver;
+  solver.create(false);
+  std::vector<f32> shadows(count);
+  f32 total_intensity = 0.0f;
+  for (u32 i = 0; i < count; ++i) {
+    out_shadows[i] = 0.0f;
+  }
+
+  for (u32 light = 0; light < light_count; ++light) {
+    solver.project(particles, count, lights[light]);
+    solver.solve(shadows.data());
+
+    for (u32 i = 0; i < count; ++i) {
+      out_light_shadows[i * light_count + light] = shadows[i];
+      out_shadows[i] += shadows[i] * lights[light].intensity;
+    }
+    total_intensity += lights[light].intensity;
+  }
+
+  for (u32 i = 0; i < count; ++i) {
+    out_shadows[i] =
+        total_intensity > 0.0f ? out_shadows[i] / total_intensity : 1.0f;
+  }
+}
+
+f32 shadowsCompare(const f32 *shadows, const f32 *reference, u32 count) {
+  f32 max_error = 0.0f;
+  for (u32 i = 0; i < count; ++i) {
+    f32 error = fabsf(shadows[i] - reference[i]) /
+                fmaxf(1.0f, fabsf(reference[i]));
+    max_error = fmaxf(max_error, error);
+  }
+
+  return max_error;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/platform.h"
+#include "light_space.h"
+#include "particle_system.h"
+
+#include <glm/glm.hpp>
+
+/* receivers per job, a multiple of the AVX2 batch so that every job starts on
+ * a stream alignment boundary */
+#define SHADOW_SOLVER_JOB_SIZE 256
+/* occluders per tile, a tile of light-space data stays in L1 while every
+ * receiver batch of the job walks over it */
+#define SHADOW_SOLVER_TILE_SIZE 512
+
+struct ShadowSolver;
+
+typedef void (*ShadowSolveFunction)(const ShadowSolver *solver, u32 begin,
+                                    u32 end, f32 *out_shadows);
+
+/* CPU implementation of particle_shadowing.comp, every receiver sums the
+ * overlap of every particle (itself included) in light space. The particles
+ * are first projected into light-space SoA streams, then the receivers are
+ * solved in parallel, 8 at a time when AVX2 is available */
+struct ShadowSolver {
+  ParticleStream x, y;
+  ParticleStream radius;
+  ParticleStream opacity;
+  u32 count = 0;
+
+  ShadowSolveFunction solve_range;
+
+  /* allow_simd = false keeps the scalar path, which follows the shader
+   * formula-for-formula and serves as the reference */
+  void create(b8 allow_simd);
+
+  void project(const Particle *particles, u32 particle_count,
+               const glm::mat4 &light_matrix);
+  void project(const ParticleSystem *particle_system,
+               const glm::mat4 &light_matrix);
+  /* directional or point light, see lightProjectDisc */
+  void project(const Particle *particles, u32 particle_count,
+               const LightSource &light);
+
+  void solve(f32 *out_shadows);
+};
+
+/* the O(N^2) definition every solver is checked against */
+void shadowsBruteForce(const Particle *particles, u32 count,
+                       const glm::mat4 &light_matrix, f32 *out_shadows);
+
+/* shadowsBruteForce per light into out_light_shadows[particle * light_count
+ * + light], and their intensity weighted mean into out_shadows */
+void shadowsBruteForceLights(const Particle *particles, u32 count,
+                             const LightSource *lights, u32 light_count,
+                             f32 *out_light_shadows, f32 *out_shadows);
+
+/* largest difference between two shadow results, relative to the reference
+ * once its magnitude exceeds 1 so that long float sums compare fairly */
+f32 shadowsCompare(const f32 *shadows, const f32 *reference, u32 count);
\ No newline at end of file